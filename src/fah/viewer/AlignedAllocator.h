@@ -0,0 +1,75 @@
+/******************************************************************************\
+
+                       This file is part of the FAHViewer.
+
+            The FAHViewer displays 3D views of Folding@home proteins.
+                    Copyright (c) 2016-2020, foldingathome.org
+                   Copyright (c) 2003-2016, Stanford University
+                               All rights reserved.
+
+       This program is free software; you can redistribute it and/or modify
+       it under the terms of the GNU General Public License as published by
+        the Free Software Foundation; either version 2 of the License, or
+                       (at your option) any later version.
+
+         This program is distributed in the hope that it will be useful,
+          but WITHOUT ANY WARRANTY; without even the implied warranty of
+          MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+                   GNU General Public License for more details.
+
+     You should have received a copy of the GNU General Public License along
+     with this program; if not, write to the Free Software Foundation, Inc.,
+           51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+                  For information regarding this software email:
+                                 Joseph Coffland
+                          joseph@cauldrondevelopment.com
+
+\******************************************************************************/
+
+
+#pragma once
+
+#include <cstdlib>
+#include <cstdint>
+#include <cstddef>
+#include <new>
+
+
+namespace FAH {
+  /// STL allocator which aligns storage for SIMD loads
+  template <typename T, std::size_t ALIGN = 32>
+  class AlignedAllocator {
+  public:
+    typedef T value_type;
+
+    template <typename U> struct rebind {
+      typedef AlignedAllocator<U, ALIGN> other;
+    };
+
+    AlignedAllocator() {}
+    template <typename U>
+    AlignedAllocator(const AlignedAllocator<U, ALIGN> &) {}
+
+    T *allocate(std::size_t n) {
+      // Over allocate and store the original pointer just before the block
+      void *ptr = std::malloc(n * sizeof(T) + ALIGN + sizeof(void *));
+      if (!ptr) throw std::bad_alloc();
+
+      uintptr_t addr = (uintptr_t)ptr + sizeof(void *) + ALIGN - 1;
+      void **aligned = (void **)(addr & ~(uintptr_t)(ALIGN - 1));
+      aligned[-1] = ptr;
+
+      return (T *)aligned;
+    }
+
+    void deallocate(T *p, std::size_t) {
+      if (p) std::free(((void **)p)[-1]);
+    }
+
+    template <typename U>
+    bool operator==(const AlignedAllocator<U, ALIGN> &) const {return true;}
+    template <typename U>
+    bool operator!=(const AlignedAllocator<U, ALIGN> &) const {return false;}
+  };
+}
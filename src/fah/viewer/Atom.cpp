@@ -158,18 +158,27 @@ SmartPointer<JSON::Value> Atom::getJSON() const {
 
 
 void Atom::loadJSON(const JSON::Value &value, float scale) {
-  if (0 < value.size()) type = value.getString(0);
-  else THROW("Atom expected list of at least length 1");
-  if (String::toUpper(type) == "UNKNOWN") type = "?";
-
-  if (1 < value.size()) charge = (float)value.getNumber(1);
-  if (2 < value.size()) radius = (float)value.getNumber(2) * scale;
-  if (3 < value.size()) mass = (float)value.getNumber(3);
-  if (4 < value.size()) number = (unsigned)value.getNumber(4);
-  else number = numberFromName(type);
-
-  if (!number) number = numberFromName(type);
-  if (!charge) charge = chargeFromNumber(number);
-  if (!radius) radius = radiusFromNumber(number);
-  if (!mass) mass = massFromNumber(number);
+  if (!value.size()) THROW("Atom expected list of at least length 1");
+
+  float charge = 1 < value.size() ? (float)value.getNumber(1) : this->charge;
+  float radius =
+    2 < value.size() ? (float)value.getNumber(2) * scale : this->radius;
+  float mass = 3 < value.size() ? (float)value.getNumber(3) : this->mass;
+  unsigned number = 4 < value.size() ? (unsigned)value.getNumber(4) : 0;
+
+  load(value.getString(0), charge, radius, mass, number);
+}
+
+
+void Atom::load(const string &type, float charge, float radius, float mass,
+                unsigned number) {
+  this->type = String::toUpper(type) == "UNKNOWN" ? "?" : type;
+  this->charge = charge;
+  this->radius = radius;
+  this->mass = mass;
+  this->number = number ? number : numberFromName(this->type);
+
+  if (!charge) this->charge = chargeFromNumber(this->number);
+  if (!radius) this->radius = radiusFromNumber(this->number);
+  if (!mass) this->mass = massFromNumber(this->number);
 }
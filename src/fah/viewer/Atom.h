@@ -86,6 +86,10 @@ namespace FAH {
 
     void setDataFromNumber(unsigned number);
 
+    /// Set all fields, filling in unset values from the atom type
+    void load(const std::string &type, float charge, float radius,
+              float mass, unsigned number);
+
     double averageBondLength(const Atom &atom) const;
 
     // From PyONObject
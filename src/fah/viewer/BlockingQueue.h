@@ -0,0 +1,113 @@
+/******************************************************************************\
+
+                       This file is part of the FAHViewer.
+
+            The FAHViewer displays 3D views of Folding@home proteins.
+                    Copyright (c) 2016-2020, foldingathome.org
+                   Copyright (c) 2003-2016, Stanford University
+                               All rights reserved.
+
+       This program is free software; you can redistribute it and/or modify
+       it under the terms of the GNU General Public License as published by
+        the Free Software Foundation; either version 2 of the License, or
+                       (at your option) any later version.
+
+         This program is distributed in the hope that it will be useful,
+          but WITHOUT ANY WARRANTY; without even the implied warranty of
+          MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+                   GNU General Public License for more details.
+
+     You should have received a copy of the GNU General Public License along
+     with this program; if not, write to the Free Software Foundation, Inc.,
+           51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+                  For information regarding this software email:
+                                 Joseph Coffland
+                          joseph@cauldrondevelopment.com
+
+\******************************************************************************/
+
+
+#pragma once
+
+#include <deque>
+#include <utility>
+#include <mutex>
+#include <condition_variable>
+
+
+namespace FAH {
+  /// A bounded queue whose producers block while it is full and whose
+  /// consumers block while it is empty.  close() wakes everyone up.
+  /// Values are moved in and out so move-only owners can be queued.
+  template <typename T>
+  class BlockingQueue {
+    std::deque<T> items;
+    unsigned capacity;
+    bool closed = false;
+
+    std::mutex lock;
+    std::condition_variable notFull;
+    std::condition_variable notEmpty;
+
+  public:
+    BlockingQueue(unsigned capacity) : capacity(capacity) {}
+
+    /// @return false if the queue was closed
+    bool push(T &&value) {
+      std::unique_lock<std::mutex> guard(lock);
+      notFull.wait(guard, [this] {return closed || items.size() < capacity;});
+      if (closed) return false;
+
+      items.push_back(std::move(value));
+      notEmpty.notify_one();
+      return true;
+    }
+
+    /// @param value is left untouched if it could not be queued
+    /// @return false if the queue is full or closed
+    bool tryPush(T &value) {
+      std::lock_guard<std::mutex> guard(lock);
+      if (closed || capacity <= items.size()) return false;
+
+      items.push_back(std::move(value));
+      notEmpty.notify_one();
+      return true;
+    }
+
+    /// @return false if the queue was closed
+    bool pop(T &value) {
+      std::unique_lock<std::mutex> guard(lock);
+      notEmpty.wait(guard, [this] {return closed || !items.empty();});
+      if (closed) return false;
+
+      value = std::move(items.front());
+      items.pop_front();
+      notFull.notify_one();
+      return true;
+    }
+
+    /// @return false if the queue is empty or closed
+    bool tryPop(T &value) {
+      std::lock_guard<std::mutex> guard(lock);
+      if (closed || items.empty()) return false;
+
+      value = std::move(items.front());
+      items.pop_front();
+      notFull.notify_one();
+      return true;
+    }
+
+    unsigned size() {
+      std::lock_guard<std::mutex> guard(lock);
+      return items.size();
+    }
+
+    void close() {
+      std::lock_guard<std::mutex> guard(lock);
+      closed = true;
+      notFull.notify_all();
+      notEmpty.notify_all();
+    }
+  };
+}
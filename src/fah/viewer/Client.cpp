@@ -31,8 +31,10 @@
 
 #include "Positions.h"
 #include "Topology.h"
+#include "Reactor.h"
 
 #include <fah/viewer/pyon/Message.h>
+#include <fah/viewer/pyon/Decoder.h>
 
 #include <cbang/String.h>
 
@@ -46,11 +48,12 @@
 
 #include <cbang/json/List.h>
 #include <cbang/json/Dict.h>
-
-#include <cbang/socket/SocketSet.h>
+#include <cbang/json/Reader.h>
 
 #include <string>
 #include <vector>
+#include <algorithm>
+#include <cstring>
 
 using namespace std;
 using namespace cb;
@@ -64,8 +67,10 @@ using namespace FAH;
 
 Client::Client(const IPAddress &addr, unsigned slot, SimulationInfo &info,
                Trajectory &trajectory, const string &password) :
-  addr(addr), password(password), slot(slot), info(info),
-  trajectory(trajectory) {
+  addr(addr), password(password), slot(slot), state(STATE_WAITING),
+  waitingForUpdate(false), loadableSlot(false), shutdown(false), slotCount(0),
+  requestedSlot(-1), generation(0), updates(64), pipeline(trajectory),
+  info(info), trajectory(trajectory) {
 
   if (!password.empty()) command = "auth \"" + password + "\"\n";
 
@@ -75,48 +80,176 @@ Client::Client(const IPAddress &addr, unsigned slot, SimulationInfo &info,
 }
 
 
+Client::~Client() {
+  shutdown = true;
+  if (registered) Reactor::instance().remove(this);
+
+  // The Reactor no longer calls this client so the backlog is ours
+  for (unsigned i = 0; i < backlog.size(); i++) delete backlog[i];
+
+  Update *update;
+  while (updates.pop(update)) delete update;
+}
+
+
 bool Client::setSlot(unsigned slot) {
-  if (waitingForUpdate || slots.size() <= slot) return false;
+  if (waitingForUpdate || slotCount <= slot) return false;
 
   this->slot = slot;
-  if (!slots.empty()) currentSlotID = slots[slot];
+  generation++; // Drop anything still queued for the old slot
+  requestedSlot = slot;
 
-  string cmd_trajectory = "updates add 3 5 $(trajectory @SLOT@)\n";
+  return true;
+}
 
-  std::size_t found = command.find(cmd_trajectory);
-  if (found != std::string::npos)
-    command.replace(found, cmd_trajectory.length(), "");
 
-  if (isConnected()) {
-    lastConnect = 0;
-    reconnect();
+bool Client::update() {
+  if (!registered) {
+    Reactor::instance().add(this);
+    registered = true;
   }
 
-  return true;
+  bool updated = false;
+  double start = Timer::now();
+  Update *ptr;
+
+  // Positions the pipeline had no room for last time
+  if (!pending.isNull()) {
+    try {
+      if (pending->generation == generation &&
+          !pipeline.push(pending->positions))
+        return pipeline.commit();
+    } CATCH_ERROR;
+
+    pending.release();
+  }
+
+  while (updates.pop(ptr)) {
+    SmartPointer<Update> update = ptr;
+    if (update->generation != generation) continue;
+
+    try {
+      if (!update->topology.isNull()) {
+        trajectory.clear();
+        trajectory.setTopology(update->topology);
+        pipeline.reset(update->topology);
+      }
+
+      if (!update->info.isNull()) info = *update->info;
+      if (!update->positions.isNull() && !pipeline.push(update->positions))
+        pending = update;
+    } CATCH_ERROR;
+
+    updated = true;
+    if (!pending.isNull() || 0.25 < Timer::now() - start) break;
+  }
+
+  // Keyframes which made it through the pipeline
+  if (pipeline.commit()) updated = true;
+
+  return updated;
 }
 
 
-bool Client::update() {
+void Client::tick() {
+  flush();
+
+  int slot = requestedSlot.exchange(-1);
+  if (0 <= slot) {
+    threadGeneration = generation;
+    changeSlot(slot);
+  }
+
   if (!isOpen()) state = STATE_WAITING;
 
   switch (state) {
   case STATE_WAITING: tryConnect(); break;
-  case STATE_CONNECTING: checkConnect(); break;
-  case STATE_HEADER: case STATE_DATA: {
-    bool updated = false;
-    double start = Timer::now();
-    while (readSome()) {
-      updated = true;
-      if (0.25 < Timer::now() - start) break;
+
+  case STATE_CONNECTING:
+    // Completion is signaled by the socket becoming writable
+    if (lastConnect + 15 < Time::now()) {
+      LOG_DEBUG(3, "Connect to " << addr << " timed out");
+      reconnect();
+    }
+    break;
+
+  default:
+    // The client sends a heartbeat every 5 seconds
+    if (lastData + 20 < Time::now()) {
+      LOG_DEBUG(3, "Connection to " << addr << " timed out");
+      reconnect();
     }
-    return updated;
+    break;
   }
+}
+
+
+bool Client::service(bool readable, bool writable, bool error) {
+  if (state == STATE_CONNECTING) {
+    if (error) {
+      reconnect();
+      return false;
+    }
+
+    if (!writable) return false;
+    connected();
+    readable = true;
   }
 
+  if (!readable || state < STATE_HEADER) return false;
+
+  // Leave the data in the socket until the render thread has caught up
+  if (!flush()) return true;
+
+  // Read until the socket would block, as required with edge triggering,
+  // but give the other clients a turn after a while
+  double start = Timer::now();
+  while (readSome())
+    if (isBlocked() || 0.25 < Timer::now() - start) return true;
+
   return false;
 }
 
 
+void Client::changeSlot(unsigned slot) {
+  if (slot < slots.size()) currentSlotID = slots[slot];
+  latestInfo = SimulationInfo();
+
+  string cmd_trajectory = "updates add 3 5 $(trajectory @SLOT@)\n";
+
+  std::size_t found = command.find(cmd_trajectory);
+  if (found != std::string::npos)
+    command.replace(found, cmd_trajectory.length(), "");
+
+  if (isConnected()) {
+    lastConnect = 0;
+    reconnect();
+  }
+}
+
+
+void Client::publish(SmartPointer<Update> &update) {
+  // The queue takes sole ownership so no reference counts are shared
+  // between threads
+  Update *ptr = update.adopt();
+
+  // Never wait for the render thread here, that would stall every client.
+  // Updates which do not fit are kept in order and reading pauses until
+  // flush() has moved them.
+  if (!flush() || !updates.push(ptr)) backlog.push_back(ptr);
+}
+
+
+bool Client::flush() {
+  while (!backlog.empty()) {
+    if (!updates.push(backlog.front())) return false;
+    backlog.pop_front();
+  }
+
+  return true;
+}
+
+
 void Client::sendCommands(const string &commands) {
   string cmds = String::replace(commands, "@SLOT@", String(currentSlotID));
 
@@ -137,45 +270,37 @@ void Client::tryConnect() {
       lastConnect = Time::now();
       setBlocking(false);
       connect(addr);
-      setTimeout(0.1);
-      buffer.clear();
+      connection++;
+      fill = consumed = 0;
       state = STATE_CONNECTING;
     } CLIENT_CATCH_ERROR;
 }
 
 
-void Client::checkConnect() {
+void Client::connected() {
   try {
-    SocketSet socketSet;
-    socketSet.add(*this, SocketSet::WRITE | SocketSet::EXCEPT);
-    socketSet.select(0);
-
-    if (!socketSet.isSet(*this, SocketSet::EXCEPT)) {
-      if (socketSet.isSet(*this, SocketSet::WRITE)) {
-        lastData = Time::now();
-        sendCommands(command);
-        state = STATE_HEADER;
-      }
-
-      return;
-    }
+    lastData = Time::now();
+    sendCommands(command);
+    state = STATE_HEADER;
+    return;
   } CLIENT_CATCH_ERROR;
 
-  // Some error occured
   reconnect();
 }
 
 
-static const char *find_string(const char *haystack, unsigned size,
+static const char *find_string(const char *haystack, const char *end,
                                const char *needle) {
-  const char *end = haystack + size;
-
-  for (const char *ptr = haystack; ptr < end; ptr++)
-    if (*ptr == *needle) {
-      const char *a = ptr;
-      const char *b = needle;
-      while (a < end && *a++ == *b++) if (!*b) return ptr; // Found
-    }
+  unsigned len = strlen(needle);
+
+  // memchr() is vectorized by the C library
+  while ((unsigned)(end - haystack) >= len) {
+    const char *ptr =
+      (const char *)memchr(haystack, *needle, end - haystack - len + 1);
+    if (!ptr) break;
+    if (!memcmp(ptr, needle, len)) return ptr; // Found
+    haystack = ptr + 1;
+  }
 
   return 0;
 }
@@ -183,77 +308,75 @@ static const char *find_string(const char *haystack, unsigned size,
 
 bool Client::readSome() {
   try {
-    // Make sure there is space
-    if (buffer.getSpace() < 4 * 1024)
-      buffer.increase(buffer.getCapacity() + 4 * 1024);
+    // Move any partial message to the front once per read, never per message
+    if (consumed) {
+      fill -= consumed;
+      memmove(buffer.data(), buffer.data() + consumed, fill);
+      if (state == STATE_DATA) {
+        messageStart -= consumed;
+        searchOffset -= consumed;
+      }
+      consumed = 0;
+    }
+
+    // Grow geometrically so large messages are read in linear time
+    if (buffer.size() - fill < 4 * 1024)
+      buffer.resize(max<size_t>(2 * buffer.size(), 64 * 1024));
 
     // Read some data
-    int count = read(buffer.end(), buffer.getSpace());
+    int count = read(buffer.data() + fill, buffer.size() - fill);
     if (count <= 0) {
       if (count < 0 || lastData + 20 < Time::now()) reconnect();
       return false;
     }
-    buffer.incFill(count);
+    if (!capture.isNull()) capture->write(buffer.data() + fill, count);
+    fill += count;
     lastData = Time::now();
     LOG_DEBUG(5, "Read " << count);
 
-    if (buffer.getFill() < 15) return true; // Not enough
+    // Frame every complete message in the new data in a single pass
+    const char *begin = buffer.data();
+    const char *end = begin + fill;
 
     do {
       switch (state) {
       case STATE_HEADER: {
         // Search for start of message
-        const char *ptr =
-            find_string(buffer.begin(), buffer.getFill(), "\nPyON ");
-
-        if (!ptr) { // Not found
-          if (4096 < buffer.getFill()) {
-            // Discard all but the end of the buffer
-            memcpy(buffer.begin(), buffer.end() - 5,  5);
-            buffer.clear(); // Reset fill to zero
-            buffer.incFill(5);
-          }
+        const char *ptr = find_string(begin + consumed, end, "\nPyON ");
+
+        if (!ptr) { // Not found, keep only what could be a partial match
+          if (5 < fill - consumed) consumed = fill - 5;
           return true;
         }
 
-        messageStart = ptr - buffer.begin() + 1; // Save offset
-        searchOffset = messageStart + 6;
+        messageStart = ptr - begin + 1; // Save offset
+        searchOffset = messageStart + 5;
         state = STATE_DATA;
         // Fall through to next case
       }
 
       case STATE_DATA: {
         // Search for end of message
-        const char *ptr =
-            find_string(buffer.begin() + searchOffset,
-                buffer.getFill() - searchOffset, "\n---\n");
+        const char *ptr = find_string(begin + searchOffset, end, "\n---\n");
 
         if (!ptr) {
-          searchOffset = buffer.getFill() - 5;
+          if (searchOffset + 4 < fill) searchOffset = fill - 4;
           return true;
         }
 
-        // Found a complete message
-        processMessage(buffer.begin() + messageStart, ptr + 5);
-
-        // Cleanup buffer
-        unsigned end = (ptr + 4) - buffer.begin();
-        if (end == buffer.getFill()) buffer.clear();
-        else {
-          unsigned remaining = buffer.getFill() - end;
-          memmove(buffer.begin(), buffer.begin() + end, remaining);
-          buffer.clear();
-          buffer.incFill(remaining);
-        }
+        // Found a complete message, parsed in place
+        processMessage(begin + messageStart, ptr + 5);
 
+        // Keep the trailing newline, it starts the next "\nPyON "
+        consumed = (ptr + 4) - begin;
         state = STATE_HEADER;
         break;     // to end of switch and continue loop
       }
 
       default: THROW("Invalid state");
       }
-      //  Continue reading as there might be more messages in the buffer
-    } while (state == STATE_HEADER && buffer.getFill() > 15);
+      //  Continue, there might be more messages in the buffer
+    } while (state == STATE_HEADER);
     return true;
   } CLIENT_CATCH_ERROR;
 
@@ -263,20 +386,57 @@ bool Client::readSome() {
 
 
 void Client::processMessage(const char *start, const char *end) {
-  PyON::Message msg;
-  ArrayStream<const char> stream(start, end - start);
+  // Header line
+  const char *eol = (const char *)memchr(start, '\n', end - start);
+  if (!eol) THROW("Invalid message");
 
-  stream >> msg;
-  if (!msg.isValid()) THROW("Invalid message");
+  PyON::Header header;
+  ArrayStream<const char> stream(start, eol + 1 - start);
+  stream >> header;
+  if (!header.isValid()) THROW("Invalid message");
 
-  LOG_DEBUG(4, "Received " << msg.getType());
+  LOG_DEBUG(4, "Received " << header.getType());
 
   try {
-    handleMessage(msg);
+    // Body, without the trailing "\n---\n"
+    const char *body = eol + 1;
+    end -= 5;
+
+    if (!decodeMessage(header.getType(), body, end)) {
+      ArrayStream<const char> stream(body, end - body);
+      JSON::Reader reader(stream);
+      handleMessage(PyON::Message(header.getType(), reader.parse()));
+    }
   } CLIENT_CATCH_ERROR;
 }
 
 
+bool Client::decodeMessage(const string &type, const char *start,
+                           const char *end) {
+  // Bulk data is decoded straight into its final form
+  if (type == "topology") {
+    PyON::Decoder decoder(start, end);
+    SmartPointer<Update> update = new Update(threadGeneration);
+    update->topology = new Topology;
+    update->topology->loadPyON(decoder);
+    waitingForUpdate = false;
+    publish(update);
+    return true;
+  }
+
+  if (type == "positions") {
+    PyON::Decoder decoder(start, end);
+    SmartPointer<Update> update = new Update(threadGeneration);
+    update->positions = new Positions;
+    update->positions->loadPyON(decoder);
+    publish(update);
+    return true;
+  }
+
+  return false;
+}
+
+
 void Client::handleMessage(const PyON::Message &msg) {
   if (msg.getType() == "slots") {
     slots.clear();
@@ -307,6 +467,8 @@ void Client::handleMessage(const PyON::Message &msg) {
       }
     }
 
+    slotCount = slots.size();
+
     if (!slots.empty()) {
       currentSlotID = slots[slot];
       const char *cmd = "updates add 2 5 $(simulation-info @SLOT@)\n";
@@ -316,30 +478,25 @@ void Client::handleMessage(const PyON::Message &msg) {
         command += cmd;
       }
 
-      info = SimulationInfo();
+      latestInfo = SimulationInfo();
+      SmartPointer<Update> update = new Update(threadGeneration);
+      update->info = new SimulationInfo(latestInfo);
+      publish(update);
     }
 
-  } else if (msg.getType() == "topology") {
-    SmartPointer<Topology> topology = new Topology;
-    topology->loadJSON(*msg.get());
-    trajectory.clear();
-    trajectory.setTopology(topology);
-    waitingForUpdate = false;
-
-  } else if (msg.getType() == "positions") {
-    SmartPointer<Positions> positions = new Positions;
-    positions->loadJSON(*msg.get());
-    trajectory.add(positions);
-
   } else if (msg.getType() == "simulation-info") {
     const JSON::Value &value = *msg.get();
     auto &dict = value.getDict();
     uint32_t coreType = (uint32_t)dict["core_type"]->getNumber();
 
-    if (coreType != 0x22 && !info.coreType)
+    if (coreType != 0x22 && !latestInfo.coreType)
       sendCommands("updates add 3 5 $(trajectory @SLOT@)\n");
 
-    info.loadJSON(*msg.get());
+    latestInfo.loadJSON(*msg.get());
     if (coreType != 0x22) loadableSlot = true;
+
+    SmartPointer<Update> update = new Update(threadGeneration);
+    update->info = new SimulationInfo(latestInfo);
+    publish(update);
   }
 }
@@ -31,11 +31,16 @@
 
 #include "SimulationInfo.h"
 #include "Trajectory.h"
+#include "TrajectoryPipeline.h"
+#include "SPSCQueue.h"
+
+#include <fah/viewer/io/SessionWriter.h>
 
 #include <cbang/socket/Socket.h>
-#include <cbang/io/MemoryBuffer.h>
 
 #include <vector>
+#include <deque>
+#include <atomic>
 #include <cstdint>
 
 
@@ -43,6 +48,11 @@ namespace FAH {
   namespace PyON {class Message;}
 
 
+  /// Talks to the client on the shared Reactor I/O thread.  Reading, message
+  /// framing and decoding happen there.  Fully built Topology, Positions and
+  /// SimulationInfo objects are handed to the render thread through a
+  /// lock-free queue, which update() drains.  New keyframes are then
+  /// processed by a TrajectoryPipeline before they are added.
   class Client : public cb::Socket {
   public:
     typedef enum {
@@ -53,25 +63,52 @@ namespace FAH {
     } state_t;
 
   protected:
+    struct Update {
+      unsigned generation;
+      cb::SmartPointer<Topology> topology;
+      cb::SmartPointer<Positions> positions;
+      cb::SmartPointer<SimulationInfo> info;
+
+      Update(unsigned generation) : generation(generation) {}
+    };
+
     cb::IPAddress addr;
     std::string password;
     std::string command;
     std::vector<uint64_t> slots;
-    unsigned slot;
+    std::atomic<unsigned> slot;
     int64_t currentSlotID = -1;
 
   private:
-    state_t state = STATE_WAITING;
+    std::atomic<state_t> state;
     uint64_t lastConnect = 0;
     uint64_t lastData = 0;
-    bool waitingForUpdate = false;
-    bool loadableSlot = false;
+    std::atomic<bool> waitingForUpdate;
+    std::atomic<bool> loadableSlot;
     bool runningGPU = false;
+    SimulationInfo latestInfo;
+    unsigned threadGeneration = 0;
 
-    cb::MemoryBuffer buffer;
+    cb::SmartPointer<SessionWriter> capture;
+
+    std::vector<char> buffer;
+    unsigned fill = 0;       ///< Bytes of valid data in buffer
+    unsigned consumed = 0;   ///< Bytes already framed and processed
     unsigned searchOffset;
     unsigned messageStart;
 
+    bool registered = false;
+    unsigned connection = 0;
+    std::atomic<bool> shutdown;
+    std::atomic<unsigned> slotCount;
+    std::atomic<int> requestedSlot;
+    std::atomic<unsigned> generation;
+    SPSCQueue<Update *> updates;
+    std::deque<Update *> backlog; ///< No room in updates, Reactor thread only
+    cb::SmartPointer<Update> pending; ///< Positions waiting for the pipeline
+
+    TrajectoryPipeline pipeline;
+
   protected:
     SimulationInfo &info;
     Trajectory &trajectory;
@@ -80,7 +117,11 @@ namespace FAH {
     Client(const cb::IPAddress &addr, unsigned slot,
            SimulationInfo &info, Trajectory &trajectory,
            const std::string &password = std::string());
-    virtual ~Client() {}
+    virtual ~Client();
+
+    /// Record everything received, must be set before the first update()
+    void setCapture(const cb::SmartPointer<SessionWriter> &capture)
+    {this->capture = capture;}
 
     const std::string &getCommand() const {return command;}
     void setCommand(const std::string &command) {this->command = command;}
@@ -89,18 +130,38 @@ namespace FAH {
     bool hasLoadableSlot() const {return loadableSlot;}
     state_t getState() const {return state;}
 
+    /// Called from the render thread, the switch happens on the I/O thread
     bool setSlot(unsigned slot);
     unsigned getSlot() const {return slot;}
 
+    /// Apply updates received by the I/O thread.  Never blocks on the network.
     bool update();
 
+    // Called on the Reactor thread
+    /// Incremented on every connection attempt
+    unsigned getConnection() const {return connection;}
+    /// Connect, switch slots and check heartbeat timeouts
+    void tick();
+    /// Handle socket readiness.  Returns true if reading stopped before all
+    /// available data was consumed.
+    bool service(bool readable, bool writable, bool error);
+    /// True while reading is paused until the render thread catches up
+    bool isBlocked() const {return !backlog.empty();}
+
   protected:
+    void changeSlot(unsigned slot);
+    void publish(cb::SmartPointer<Update> &update);
+    /// @return true if the backlog was fully moved to the update queue
+    bool flush();
+
     void sendCommands(const std::string &commands);
     void reconnect();
     void tryConnect();
-    void checkConnect();
+    void connected();
     bool readSome();
     void processMessage(const char *start, const char *end);
+    bool decodeMessage(const std::string &type, const char *start,
+                       const char *end);
     virtual void handleMessage(const PyON::Message &msg);
   };
 }
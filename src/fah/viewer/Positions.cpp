@@ -29,43 +29,293 @@
 
 #include "Positions.h"
 
+#include <cbang/Exception.h>
 #include <cbang/log/Logger.h>
+#include <cbang/json/List.h>
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || \
+  (defined(_M_IX86_FP) && 2 <= _M_IX86_FP)
+#define FAH_POSITIONS_SSE
+#include <emmintrin.h>
+#endif
+
+// AVX2 is chosen at runtime so the build does not require it
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define FAH_POSITIONS_AVX2
+#include <immintrin.h>
+#endif
 
 using namespace std;
 using namespace cb;
 using namespace FAH;
 
 
-void Positions::init() {
-  // Compute radius as max distance from origin
-  radius = 0;
-  Vector3D origin;
+namespace {
+  struct Extents {
+    double sum[3];
+    float min[3];
+    float max[3];
+    float maxR2;
+
+    Extents() : maxR2(0) {
+      for (int k = 0; k < 3; k++) {
+        sum[k] = 0;
+        min[k] = FLT_MAX;
+        max[k] = -FLT_MAX;
+      }
+    }
+  };
+
+
+  // Shifting writes the coordinates, otherwise they are only read
+  template <bool SHIFT> struct Coords {typedef const float *ptr_t;};
+  template <> struct Coords<true> {typedef float *ptr_t;};
+
+
+  inline void store(float *p, float v) {*p = v;}
+  inline void store(const float *, float) {}
+
+
+#ifdef FAH_POSITIONS_SSE
+  inline void store(float *p, __m128 v) {_mm_store_ps(p, v);}
+  inline void store(const float *, __m128) {}
+
+
+  // Processes whole groups of four and returns where the scalar tail starts
+  template <bool SHIFT>
+  unsigned scanSSE(typename Coords<SHIFT>::ptr_t x,
+                   typename Coords<SHIFT>::ptr_t y,
+                   typename Coords<SHIFT>::ptr_t z, unsigned n,
+                   const float d[3], Extents &e) {
+    const __m128 dx = _mm_set1_ps(d[0]);
+    const __m128 dy = _mm_set1_ps(d[1]);
+    const __m128 dz = _mm_set1_ps(d[2]);
+
+    __m128 minX = _mm_set1_ps(FLT_MAX), maxX = _mm_set1_ps(-FLT_MAX);
+    __m128 minY = minX, maxY = maxX, minZ = minX, maxZ = maxX;
+    __m128 r2 = _mm_setzero_ps();
+    __m128d sumX = _mm_setzero_pd(), sumY = sumX, sumZ = sumX;
+
+    // The arrays are aligned so only the tail needs scalar handling
+    unsigned i = 0;
+    for (; i + 4 <= n; i += 4) {
+      __m128 vx = _mm_load_ps(x + i);
+      __m128 vy = _mm_load_ps(y + i);
+      __m128 vz = _mm_load_ps(z + i);
+
+      if (SHIFT) {
+        vx = _mm_add_ps(vx, dx);
+        vy = _mm_add_ps(vy, dy);
+        vz = _mm_add_ps(vz, dz);
+        store(x + i, vx);
+        store(y + i, vy);
+        store(z + i, vz);
+      }
+
+      minX = _mm_min_ps(minX, vx); maxX = _mm_max_ps(maxX, vx);
+      minY = _mm_min_ps(minY, vy); maxY = _mm_max_ps(maxY, vy);
+      minZ = _mm_min_ps(minZ, vz); maxZ = _mm_max_ps(maxZ, vz);
+
+      __m128 d2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(vx, vx),
+                                        _mm_mul_ps(vy, vy)),
+                             _mm_mul_ps(vz, vz));
+      r2 = _mm_max_ps(r2, d2);
+
+      // Accumulate sums in double to keep the centroid exact enough
+      sumX = _mm_add_pd(sumX, _mm_cvtps_pd(vx));
+      sumX = _mm_add_pd(sumX, _mm_cvtps_pd(_mm_movehl_ps(vx, vx)));
+      sumY = _mm_add_pd(sumY, _mm_cvtps_pd(vy));
+      sumY = _mm_add_pd(sumY, _mm_cvtps_pd(_mm_movehl_ps(vy, vy)));
+      sumZ = _mm_add_pd(sumZ, _mm_cvtps_pd(vz));
+      sumZ = _mm_add_pd(sumZ, _mm_cvtps_pd(_mm_movehl_ps(vz, vz)));
+    }
+
+    // Horizontal reductions
+    alignas(16) float f[4][4];
+    _mm_store_ps(f[0], minX); _mm_store_ps(f[1], minY);
+    _mm_store_ps(f[2], minZ); _mm_store_ps(f[3], r2);
+    for (int j = 0; j < 4; j++) {
+      for (int k = 0; k < 3; k++) e.min[k] = std::min(e.min[k], f[k][j]);
+      e.maxR2 = std::max(e.maxR2, f[3][j]);
+    }
+
+    _mm_store_ps(f[0], maxX); _mm_store_ps(f[1], maxY);
+    _mm_store_ps(f[2], maxZ);
+    for (int j = 0; j < 4; j++)
+      for (int k = 0; k < 3; k++) e.max[k] = std::max(e.max[k], f[k][j]);
+
+    alignas(16) double s[3][2];
+    _mm_store_pd(s[0], sumX);
+    _mm_store_pd(s[1], sumY);
+    _mm_store_pd(s[2], sumZ);
+    for (int k = 0; k < 3; k++) e.sum[k] += s[k][0] + s[k][1];
+
+    return i;
+  }
+#endif // FAH_POSITIONS_SSE
+
+
+#ifdef FAH_POSITIONS_AVX2
+  __attribute__((target("avx2")))
+  inline void store(float *p, __m256 v) {_mm256_store_ps(p, v);}
+  __attribute__((target("avx2")))
+  inline void store(const float *, __m256) {}
+
+
+  // As scanSSE() with groups of eight
+  template <bool SHIFT> __attribute__((target("avx2")))
+  unsigned scanAVX2(typename Coords<SHIFT>::ptr_t x,
+                    typename Coords<SHIFT>::ptr_t y,
+                    typename Coords<SHIFT>::ptr_t z, unsigned n,
+                    const float d[3], Extents &e) {
+    const __m256 dx = _mm256_set1_ps(d[0]);
+    const __m256 dy = _mm256_set1_ps(d[1]);
+    const __m256 dz = _mm256_set1_ps(d[2]);
+
+    __m256 minX = _mm256_set1_ps(FLT_MAX), maxX = _mm256_set1_ps(-FLT_MAX);
+    __m256 minY = minX, maxY = maxX, minZ = minX, maxZ = maxX;
+    __m256 r2 = _mm256_setzero_ps();
+    __m256d sumX = _mm256_setzero_pd(), sumY = sumX, sumZ = sumX;
+
+    // The arrays are 32 byte aligned
+    unsigned i = 0;
+    for (; i + 8 <= n; i += 8) {
+      __m256 vx = _mm256_load_ps(x + i);
+      __m256 vy = _mm256_load_ps(y + i);
+      __m256 vz = _mm256_load_ps(z + i);
+
+      if (SHIFT) {
+        vx = _mm256_add_ps(vx, dx);
+        vy = _mm256_add_ps(vy, dy);
+        vz = _mm256_add_ps(vz, dz);
+        store(x + i, vx);
+        store(y + i, vy);
+        store(z + i, vz);
+      }
+
+      minX = _mm256_min_ps(minX, vx); maxX = _mm256_max_ps(maxX, vx);
+      minY = _mm256_min_ps(minY, vy); maxY = _mm256_max_ps(maxY, vy);
+      minZ = _mm256_min_ps(minZ, vz); maxZ = _mm256_max_ps(maxZ, vz);
+
+      // No FMA so the radius matches the other paths exactly
+      __m256 d2 = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(vx, vx),
+                                              _mm256_mul_ps(vy, vy)),
+                                _mm256_mul_ps(vz, vz));
+      r2 = _mm256_max_ps(r2, d2);
+
+      sumX = _mm256_add_pd(sumX, _mm256_cvtps_pd(_mm256_castps256_ps128(vx)));
+      sumX = _mm256_add_pd(sumX, _mm256_cvtps_pd(_mm256_extractf128_ps(vx, 1)));
+      sumY = _mm256_add_pd(sumY, _mm256_cvtps_pd(_mm256_castps256_ps128(vy)));
+      sumY = _mm256_add_pd(sumY, _mm256_cvtps_pd(_mm256_extractf128_ps(vy, 1)));
+      sumZ = _mm256_add_pd(sumZ, _mm256_cvtps_pd(_mm256_castps256_ps128(vz)));
+      sumZ = _mm256_add_pd(sumZ, _mm256_cvtps_pd(_mm256_extractf128_ps(vz, 1)));
+    }
+
+    alignas(32) float f[4][8];
+    _mm256_store_ps(f[0], minX); _mm256_store_ps(f[1], minY);
+    _mm256_store_ps(f[2], minZ); _mm256_store_ps(f[3], r2);
+    for (int j = 0; j < 8; j++) {
+      for (int k = 0; k < 3; k++) e.min[k] = std::min(e.min[k], f[k][j]);
+      e.maxR2 = std::max(e.maxR2, f[3][j]);
+    }
+
+    _mm256_store_ps(f[0], maxX); _mm256_store_ps(f[1], maxY);
+    _mm256_store_ps(f[2], maxZ);
+    for (int j = 0; j < 8; j++)
+      for (int k = 0; k < 3; k++) e.max[k] = std::max(e.max[k], f[k][j]);
+
+    alignas(32) double s[3][4];
+    _mm256_store_pd(s[0], sumX);
+    _mm256_store_pd(s[1], sumY);
+    _mm256_store_pd(s[2], sumZ);
+    for (int k = 0; k < 3; k++)
+      e.sum[k] += (s[k][0] + s[k][1]) + (s[k][2] + s[k][3]);
+
+    return i;
+  }
 
-  for (unsigned i = 0; i < size(); i++) {
-    double r = at(i).distance(origin);
-    if (radius < r) radius = r;
+
+  bool haveAVX2() {
+    static const bool avx2 = __builtin_cpu_supports("avx2");
+    return avx2;
+  }
+#endif // FAH_POSITIONS_AVX2
+
+
+  // Single pass over the coordinate arrays which optionally shifts every
+  // position by d while accumulating the centroid sums, bounds and maximum
+  // squared distance from the origin.  The widest vector unit the CPU
+  // supports handles whole groups and the scalar loop finishes the tail.
+  template <bool SHIFT>
+  void scan(typename Coords<SHIFT>::ptr_t x, typename Coords<SHIFT>::ptr_t y,
+            typename Coords<SHIFT>::ptr_t z, unsigned n, const float d[3],
+            Extents &e) {
+    unsigned i = 0;
+
+#ifdef FAH_POSITIONS_AVX2
+    if (16 <= n && haveAVX2()) i = scanAVX2<SHIFT>(x, y, z, n, d, e);
+#endif
+#ifdef FAH_POSITIONS_SSE
+    if (!i && 8 <= n) i = scanSSE<SHIFT>(x, y, z, n, d, e);
+#endif
+
+    for (; i < n; i++) {
+      float v[3] = {x[i], y[i], z[i]};
+
+      if (SHIFT) {
+        for (int k = 0; k < 3; k++) v[k] += d[k];
+        store(x + i, v[0]);
+        store(y + i, v[1]);
+        store(z + i, v[2]);
+      }
+
+      for (int k = 0; k < 3; k++) {
+        if (v[k] < e.min[k]) e.min[k] = v[k];
+        if (e.max[k] < v[k]) e.max[k] = v[k];
+        e.sum[k] += v[k];
+      }
+
+      float d2 = v[0] * v[0] + v[1] * v[1] + v[2] * v[2];
+      if (e.maxR2 < d2) e.maxR2 = d2;
+    }
   }
+}
 
-  // Find bounds
-  bounds = Rectangle3D();
-  for (unsigned i = 0; i < size(); i++) bounds.add(at(i));
+
+void Positions::init() {
+  const float d[3] = {0, 0, 0};
+  Extents e;
+
+  scan<false>(x.data(), y.data(), z.data(), size(), d, e);
+  setExtents(e.min, e.max, e.maxR2);
 }
 
 
 void Positions::translate(const Vector3D &offset) {
-  for (unsigned i = 0; i < size(); i++)
-    at(i) += offset;
+  const float d[3] = {(float)offset.x(), (float)offset.y(), (float)offset.z()};
+  Extents e;
 
-  this->offset += offset;
+  // Shift and recompute the bounds and radius in the same pass
+  scan<true>(x.data(), y.data(), z.data(), size(), d, e);
+  setExtents(e.min, e.max, e.maxR2);
 
-  init();
+  this->offset += offset;
 }
 
 
 Vector3D Positions::findCenterOfMass() const {
-  Vector3D com;
-  for (unsigned i = 0; i < size(); i++) com += at(i);
-  return com / size();
+  if (empty()) return Vector3D();
+
+  const float d[3] = {0, 0, 0};
+  Extents e;
+
+  scan<false>(x.data(), y.data(), z.data(), size(), d, e);
+
+  return Vector3D(e.sum[0], e.sum[1], e.sum[2]) / size();
 }
 
 
@@ -74,14 +324,52 @@ void Positions::translateToCenterOfMass() {
 }
 
 
+void Positions::interpolate(const Positions &p1, const Positions &p2,
+                            double t) {
+  resize(p1.size());
+  box = p1.box;
+  offset = p1.offset;
+
+  unsigned n = p1.size() < p2.size() ? p1.size() : p2.size();
+  float a = (float)(1 - t);
+  float b = (float)t;
+
+  for (unsigned i = 0; i < n; i++) {
+    x[i] = a * p1.x[i] + b * p2.x[i];
+    y[i] = a * p1.y[i] + b * p2.y[i];
+    z[i] = a * p1.z[i] + b * p2.z[i];
+  }
+
+  for (unsigned i = n; i < p1.size(); i++) {
+    x[i] = p1.x[i];
+    y[i] = p1.y[i];
+    z[i] = p1.z[i];
+  }
+
+  init();
+}
+
+
+void Positions::setExtents(const float min[3], const float max[3],
+                           float maxR2) {
+  radius = sqrt((double)maxR2);
+
+  bounds = Rectangle3D();
+  if (!empty()) {
+    bounds.add(Vector3D(min[0], min[1], min[2]));
+    bounds.add(Vector3D(max[0], max[1], max[2]));
+  }
+}
+
+
 SmartPointer<JSON::Value> Positions::getJSON() const {
   SmartPointer<JSON::Value> list = new JSON::List;
 
-  for (const_iterator it = begin(); it != end(); it++) {
+  for (unsigned i = 0; i < size(); i++) {
     SmartPointer<JSON::Value> coord = new JSON::List;
-    coord->append(it->x());
-    coord->append(it->y());
-    coord->append(it->z());
+    coord->append(x[i]);
+    coord->append(y[i]);
+    coord->append(z[i]);
     list->append(coord);
   }
 
@@ -91,6 +379,7 @@ SmartPointer<JSON::Value> Positions::getJSON() const {
 
 void Positions::loadJSON(const JSON::Value &value, float scale) {
   clear();
+  reserve(value.size());
 
   for (unsigned i = 0; i < value.size(); i++) {
     auto &coord = value.getList(i);
@@ -104,3 +393,35 @@ void Positions::loadJSON(const JSON::Value &value, float scale) {
 
   init();
 }
+
+
+void Positions::loadPyON(PyON::Decoder &decoder, float scale) {
+  // One '[' per coordinate plus the outer list bounds the atom count so the
+  // coordinates can be written straight into the arrays
+  unsigned n = decoder.count('[');
+  resize(n ? n - 1 : 0);
+
+  unsigned count = 0;
+  decoder.expect('[');
+
+  if (!decoder.tryChar(']'))
+    do {
+      if (count == x.size()) THROW("Too many positions");
+
+      decoder.expect('[');
+      x[count] = decoder.parseNumber() * scale;
+      decoder.expect(',');
+      y[count] = decoder.parseNumber() * scale;
+      decoder.expect(',');
+      z[count] = decoder.parseNumber() * scale;
+      decoder.tryChar(',');
+      decoder.expect(']');
+      count++;
+    } while (!decoder.nextItem(']'));
+
+  resize(count);
+
+  LOG_DEBUG(3, "Read " << size() << " PyON positions");
+
+  init();
+}
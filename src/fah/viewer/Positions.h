@@ -29,16 +29,29 @@
 
 #pragma once
 
+#include "AlignedAllocator.h"
+
 #include <fah/viewer/pyon/Object.h>
+#include <fah/viewer/pyon/Decoder.h>
 
 #include <cbang/geom/Rectangle.h>
 #include <cbang/time/TimeStamp.h>
 
 #include <vector>
+#include <cstdint>
 
 namespace FAH {
-  class Positions : public PyON::Object, public std::vector<cb::Vector3D>,
-                    public cb::TimeStamp {
+  /// Atom coordinates stored as separate, aligned, single precision x, y and
+  /// z arrays.  Derived values such as the bounds are kept in double.
+  class Positions : public PyON::Object, public cb::TimeStamp {
+  public:
+    typedef std::vector<float, AlignedAllocator<float> > coords_t;
+
+  protected:
+    coords_t x;
+    coords_t y;
+    coords_t z;
+
     std::vector<cb::Vector3D> box;
     double radius;
     cb::Rectangle3D bounds;
@@ -49,6 +62,32 @@ namespace FAH {
     Positions(const cb::JSON::Value &value, float scale = 1) : radius(0)
     {loadJSON(value, scale);}
 
+    unsigned size() const {return x.size();}
+    bool empty() const {return x.empty();}
+    void clear() {x.clear(); y.clear(); z.clear();}
+    void reserve(unsigned n) {x.reserve(n); y.reserve(n); z.reserve(n);}
+    void resize(unsigned n) {x.resize(n); y.resize(n); z.resize(n);}
+
+    cb::Vector3D operator[](unsigned i) const
+    {return cb::Vector3D(x[i], y[i], z[i]);}
+    cb::Vector3D at(unsigned i) const
+    {return cb::Vector3D(x.at(i), y.at(i), z.at(i));}
+
+    void set(unsigned i, const cb::Vector3D &p)
+    {x[i] = (float)p.x(); y[i] = (float)p.y(); z[i] = (float)p.z();}
+    void push_back(const cb::Vector3D &p) {
+      x.push_back((float)p.x());
+      y.push_back((float)p.y());
+      z.push_back((float)p.z());
+    }
+
+    float *getX() {return x.data();}
+    float *getY() {return y.data();}
+    float *getZ() {return z.data();}
+    const float *getX() const {return x.data();}
+    const float *getY() const {return y.data();}
+    const float *getZ() const {return z.data();}
+
     void setBox(const std::vector<cb::Vector3D> &box) {this->box = box;}
     const std::vector<cb::Vector3D> &getBox() const {return box;}
 
@@ -58,17 +97,32 @@ namespace FAH {
     void setOffset(const cb::Vector3D &offset) {this->offset = offset;}
     const cb::Vector3D &getOffset() const {return offset;}
 
+    uint64_t getMemoryUsage() const {
+      return 3 * x.capacity() * sizeof(float) +
+        box.capacity() * sizeof(cb::Vector3D);
+    }
+
     void init();
 
     void translate(const cb::Vector3D &offset);
     cb::Vector3D findCenterOfMass() const;
     void translateToCenterOfMass();
 
+    /// Set this to the linear interpolation from @param p1 to @param p2
+    void interpolate(const Positions &p1, const Positions &p2, double t);
+
+  protected:
+    void setExtents(const float min[3], const float max[3], float maxR2);
+
+  public:
     // From PyONObject
     const char *getPyONType() const {return "positions";}
     cb::SmartPointer<cb::JSON::Value> getJSON() const;
     void loadJSON(const cb::JSON::Value &value) {loadJSON(value, 1);}
 
     void loadJSON(const cb::JSON::Value &value, float scale);
+
+    /// Decode a PyON positions value without building a JSON DOM
+    void loadPyON(PyON::Decoder &decoder, float scale = 1);
   };
 }
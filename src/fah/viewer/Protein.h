@@ -48,7 +48,12 @@ namespace FAH {
       topology(topology), positions(positions),
       radius(positions.isNull() ? 0 : positions->getRadius()) {}
 
+    void setTopology(const cb::SmartPointer<Topology> &topology)
+    {this->topology = topology;}
     const cb::SmartPointer<Topology> &getTopology() const {return topology;}
+
+    void setPositions(const cb::SmartPointer<Positions> &positions)
+    {this->positions = positions;}
     const cb::SmartPointer<Positions> &getPositions() const {return positions;}
 
     void setRadius(double radius) {this->radius = radius;}
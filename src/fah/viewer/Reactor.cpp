@@ -0,0 +1,297 @@
+/******************************************************************************\
+
+                       This file is part of the FAHViewer.
+
+            The FAHViewer displays 3D views of Folding@home proteins.
+                    Copyright (c) 2016-2020, foldingathome.org
+                   Copyright (c) 2003-2016, Stanford University
+                               All rights reserved.
+
+       This program is free software; you can redistribute it and/or modify
+       it under the terms of the GNU General Public License as published by
+        the Free Software Foundation; either version 2 of the License, or
+                       (at your option) any later version.
+
+         This program is distributed in the hope that it will be useful,
+          but WITHOUT ANY WARRANTY; without even the implied warranty of
+          MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+                   GNU General Public License for more details.
+
+     You should have received a copy of the GNU General Public License along
+     with this program; if not, write to the Free Software Foundation, Inc.,
+           51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+                  For information regarding this software email:
+                                 Joseph Coffland
+                          joseph@cauldrondevelopment.com
+
+\******************************************************************************/
+
+
+#include "Reactor.h"
+#include "Client.h"
+
+#include <cbang/Exception.h>
+#include <cbang/Catch.h>
+#include <cbang/log/Logger.h>
+
+#ifdef FAH_REACTOR_EPOLL
+#include <sys/epoll.h>
+#include <unistd.h>
+#else
+#include <cbang/socket/SocketSet.h>
+#endif
+
+#include <chrono>
+#include <cerrno>
+#include <cstring>
+
+using namespace std;
+using namespace cb;
+using namespace FAH;
+
+
+Reactor::Reactor() : shutdown(false) {
+#ifdef FAH_REACTOR_EPOLL
+  epollFD = epoll_create1(EPOLL_CLOEXEC);
+  if (epollFD == -1) THROW("Creating epoll instance: " << strerror(errno));
+#endif
+}
+
+
+Reactor::~Reactor() {
+  shutdown = true;
+  if (thread.joinable()) thread.join();
+
+#ifdef FAH_REACTOR_EPOLL
+  ::close(epollFD);
+#endif
+}
+
+
+Reactor &Reactor::instance() {
+  static Reactor reactor;
+  return reactor;
+}
+
+
+void Reactor::add(Client *client) {
+  lock_guard<mutex> guard(lock);
+
+  entries.push_back(Entry(client));
+  if (!thread.joinable()) thread = std::thread(&Reactor::run, this);
+}
+
+
+void Reactor::remove(Client *client) {
+  unique_lock<mutex> guard(lock);
+
+  // Wait out a call in progress, calls never block so this is short
+  serviced.wait(guard, [this, client] {return servicing != client;});
+
+  for (auto it = entries.begin(); it != entries.end(); it++)
+    if (it->client == client) {
+#ifdef FAH_REACTOR_EPOLL
+      if (it->connection && client->isOpen())
+        epoll_ctl(epollFD, EPOLL_CTL_DEL, client->get(), 0);
+#endif
+
+      entries.erase(it);
+      break;
+    }
+}
+
+
+void Reactor::run() {
+  while (!shutdown) {
+    bool pending = false;
+    bool blocked = false;
+
+    unique_lock<mutex> guard(lock);
+
+    // Entries may be added or removed while the lock is dropped, so clients
+    // are looked up again after every call
+    vector<Client *> clients;
+    for (unsigned i = 0; i < entries.size(); i++)
+      clients.push_back(entries[i].client);
+
+    for (unsigned i = 0; i < clients.size(); i++) {
+      Client *client = clients[i];
+      if (!find(client)) continue;
+
+      // Connect, change slots and check for lost connections
+      enter(guard, client);
+      client->tick();
+      leave(guard);
+
+      Entry *entry = find(client);
+      if (!entry) continue;
+
+#ifdef FAH_REACTOR_EPOLL
+      // Register new connections.  Closed sockets drop out of the epoll
+      // set on their own.
+      unsigned connection = client->isOpen() ? client->getConnection() : 0;
+
+      if (connection != entry->connection) {
+        entry->connection = connection;
+        entry->pending = false;
+
+        if (connection) {
+          epoll_event event;
+          event.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+          event.data.ptr = client;
+
+          if (epoll_ctl(epollFD, EPOLL_CTL_ADD, client->get(), &event))
+            LOG_ERROR("Adding socket to epoll: " << strerror(errno));
+        }
+      }
+#endif
+
+      // Finish reading sockets which were left with data on the last pass
+      if (!entry->pending) continue;
+
+      enter(guard, client);
+      bool more = client->service(true, false, false);
+      bool paused = more && client->isBlocked();
+      leave(guard);
+
+      entry = find(client);
+      if (!entry) continue;
+
+      entry->pending = more;
+      if (paused) blocked = true;
+      else if (more) pending = true;
+    }
+
+    guard.unlock();
+
+    // Clients waiting on the render thread are retried at a gentle pace
+    wait(pending ? 0 : (blocked ? 0.005 : 0.1));
+  }
+}
+
+
+#ifdef FAH_REACTOR_EPOLL
+void Reactor::wait(double timeout) {
+  const int maxEvents = 64;
+  epoll_event events[maxEvents];
+
+  int count = epoll_wait(epollFD, events, maxEvents, (int)(timeout * 1000));
+  if (count < 0) {
+    if (errno != EINTR) LOG_ERROR("epoll_wait(): " << strerror(errno));
+    return;
+  }
+
+  unique_lock<mutex> guard(lock);
+
+  for (int i = 0; i < count; i++) {
+    // The client may have been removed while waiting
+    Client *client = (Client *)events[i].data.ptr;
+    Entry *entry = find(client);
+    if (!entry || !entry->connection) continue;
+
+    uint32_t flags = events[i].events;
+
+    enter(guard, client);
+    bool more = client->service(flags & (EPOLLIN | EPOLLRDHUP | EPOLLHUP),
+                                flags & EPOLLOUT, flags & EPOLLERR);
+    leave(guard);
+
+    entry = find(client);
+    if (entry) entry->pending = more;
+  }
+}
+
+
+#else // FAH_REACTOR_EPOLL
+void Reactor::wait(double timeout) {
+  struct Ready {
+    Client *client;
+    bool readable;
+    bool writable;
+    bool error;
+  };
+
+  vector<Ready> ready;
+  unique_lock<mutex> guard(lock);
+
+  {
+    // Keep the lock so no socket is closed by remove() during select()
+    SocketSet sockets;
+    bool empty = true;
+
+    for (unsigned i = 0; i < entries.size(); i++) {
+      Client &client = *entries[i].client;
+      if (!client.isOpen()) continue;
+
+      if (client.getState() == Client::STATE_CONNECTING)
+        sockets.add(client, SocketSet::WRITE | SocketSet::EXCEPT);
+
+      // A blocked client's socket stays readable, select() would return
+      // at once.  run() retries it since it is still pending.
+      else if (client.isBlocked()) sockets.add(client, SocketSet::EXCEPT);
+      else sockets.add(client, SocketSet::READ);
+
+      empty = false;
+    }
+
+    if (empty) {
+      guard.unlock();
+      this_thread::sleep_for(chrono::milliseconds((int)(timeout * 1000)));
+      return;
+    }
+
+    try {
+      if (!sockets.select(timeout)) return;
+    } CATCH_ERROR;
+
+    for (unsigned i = 0; i < entries.size(); i++) {
+      Client &client = *entries[i].client;
+      if (!client.isOpen()) continue;
+
+      Ready r = {
+        &client,
+        sockets.isSet(client, SocketSet::READ),
+        sockets.isSet(client, SocketSet::WRITE),
+        sockets.isSet(client, SocketSet::EXCEPT),
+      };
+
+      if (r.readable || r.writable || r.error) ready.push_back(r);
+    }
+  }
+
+  for (unsigned i = 0; i < ready.size(); i++) {
+    Client *client = ready[i].client;
+    if (!find(client)) continue;
+
+    enter(guard, client);
+    bool more =
+      client->service(ready[i].readable, ready[i].writable, ready[i].error);
+    leave(guard);
+
+    Entry *entry = find(client);
+    if (entry) entry->pending = more;
+  }
+}
+#endif // FAH_REACTOR_EPOLL
+
+
+void Reactor::enter(unique_lock<mutex> &guard, Client *client) {
+  servicing = client;
+  guard.unlock();
+}
+
+
+void Reactor::leave(unique_lock<mutex> &guard) {
+  guard.lock();
+  servicing = 0;
+  serviced.notify_all();
+}
+
+
+Reactor::Entry *Reactor::find(Client *client) {
+  for (unsigned i = 0; i < entries.size(); i++)
+    if (entries[i].client == client) return &entries[i];
+
+  return 0;
+}
@@ -0,0 +1,92 @@
+/******************************************************************************\
+
+                       This file is part of the FAHViewer.
+
+            The FAHViewer displays 3D views of Folding@home proteins.
+                    Copyright (c) 2016-2020, foldingathome.org
+                   Copyright (c) 2003-2016, Stanford University
+                               All rights reserved.
+
+       This program is free software; you can redistribute it and/or modify
+       it under the terms of the GNU General Public License as published by
+        the Free Software Foundation; either version 2 of the License, or
+                       (at your option) any later version.
+
+         This program is distributed in the hope that it will be useful,
+          but WITHOUT ANY WARRANTY; without even the implied warranty of
+          MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+                   GNU General Public License for more details.
+
+     You should have received a copy of the GNU General Public License along
+     with this program; if not, write to the Free Software Foundation, Inc.,
+           51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+                  For information regarding this software email:
+                                 Joseph Coffland
+                          joseph@cauldrondevelopment.com
+
+\******************************************************************************/
+
+
+#pragma once
+
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <thread>
+
+#ifdef __linux__
+#define FAH_REACTOR_EPOLL
+#endif
+
+
+namespace FAH {
+  class Client;
+
+  /// Runs the sockets of every Client on one I/O thread.  Connection
+  /// completion and incoming data are waited for with edge-triggered epoll
+  /// on Linux and select() elsewhere.  Connect retries and heartbeat
+  /// timeouts are checked on each pass.  The lock is not held while a
+  /// client is called, so add() and remove() never wait on client work.
+  class Reactor {
+    struct Entry {
+      Client *client;
+      unsigned connection; ///< Connection registered with epoll, 0 for none
+      bool pending;        ///< Stopped reading before the socket was drained
+
+      Entry(Client *client) : client(client), connection(0), pending(false) {}
+    };
+
+    std::mutex lock;
+    std::condition_variable serviced;
+    Client *servicing = 0; ///< The client being called without the lock
+    std::vector<Entry> entries;
+    std::thread thread;
+    std::atomic<bool> shutdown;
+
+#ifdef FAH_REACTOR_EPOLL
+    int epollFD = -1;
+#endif
+
+  public:
+    Reactor();
+    ~Reactor();
+
+    static Reactor &instance();
+
+    void add(Client *client);
+    /// Blocks until @param client is no longer being serviced
+    void remove(Client *client);
+
+  protected:
+    void run();
+    void wait(double timeout);
+    Entry *find(Client *client);
+
+    /// Drop the lock to call @param client
+    void enter(std::unique_lock<std::mutex> &guard, Client *client);
+    /// Retake the lock and wake any remove() waiting on the client
+    void leave(std::unique_lock<std::mutex> &guard);
+  };
+}
@@ -0,0 +1,142 @@
+/******************************************************************************\
+
+                       This file is part of the FAHViewer.
+
+            The FAHViewer displays 3D views of Folding@home proteins.
+                    Copyright (c) 2016-2020, foldingathome.org
+                   Copyright (c) 2003-2016, Stanford University
+                               All rights reserved.
+
+       This program is free software; you can redistribute it and/or modify
+       it under the terms of the GNU General Public License as published by
+        the Free Software Foundation; either version 2 of the License, or
+                       (at your option) any later version.
+
+         This program is distributed in the hope that it will be useful,
+          but WITHOUT ANY WARRANTY; without even the implied warranty of
+          MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+                   GNU General Public License for more details.
+
+     You should have received a copy of the GNU General Public License along
+     with this program; if not, write to the Free Software Foundation, Inc.,
+           51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+                  For information regarding this software email:
+                                 Joseph Coffland
+                          joseph@cauldrondevelopment.com
+
+\******************************************************************************/
+
+
+#include "ReplayServer.h"
+
+#include <fah/viewer/io/SessionReader.h>
+
+#include <cbang/Exception.h>
+#include <cbang/Catch.h>
+#include <cbang/log/Logger.h>
+#include <cbang/socket/Socket.h>
+#include <cbang/time/Timer.h>
+
+#include <algorithm>
+#include <chrono>
+
+using namespace std;
+using namespace cb;
+using namespace FAH;
+
+
+namespace {
+  void sleep(double seconds) {
+    this_thread::sleep_for(chrono::microseconds((int64_t)(seconds * 1e6)));
+  }
+}
+
+
+ReplayServer::ReplayServer(const string &path, const IPAddress &addr,
+                           double speed) :
+  path(path), addr(addr), speed(speed), shutdown(false) {}
+
+
+ReplayServer::~ReplayServer() {
+  shutdown = true;
+  if (thread.joinable()) thread.join();
+}
+
+
+void ReplayServer::start() {
+  if (!thread.joinable()) thread = std::thread(&ReplayServer::run, this);
+}
+
+
+void ReplayServer::run() {
+  try {
+    Socket server;
+    server.open();
+    server.setReuseAddr(true);
+    server.bind(addr);
+    server.listen();
+    server.setBlocking(false);
+
+    LOG_INFO(1, "Replaying '" << path << "' on " << addr);
+
+    while (!shutdown) {
+      SmartPointer<Socket> socket = server.accept();
+
+      if (socket.isNull()) sleep(0.1);
+      else
+        try {
+          serve(*socket);
+        } CATCH_ERROR;
+    }
+  } CATCH_ERROR;
+}
+
+
+void ReplayServer::serve(Socket &socket) {
+  SessionReader reader(path);
+  socket.setBlocking(true);
+
+  double start = Timer::now();
+  double time;
+  string data;
+  uint64_t bytes = 0;
+  unsigned records = 0;
+
+  while (!shutdown && reader.read(time, data)) {
+    // Wait in short slices so shutdown is not held up by long gaps
+    while (speed && !shutdown) {
+      double delay = start + time / speed - Timer::now();
+      if (delay <= 0) break;
+      sleep(min(delay, 0.1));
+    }
+
+    if (shutdown) break;
+
+    const char *ptr = data.data();
+    streamsize remaining = data.size();
+
+    while (remaining) {
+      streamsize count = socket.write(ptr, remaining);
+      ptr += count;
+      remaining -= count;
+    }
+
+    bytes += data.size();
+    records++;
+  }
+
+  LOG_INFO(1, "Replayed " << records << " records, " << bytes << " bytes in "
+           << (Timer::now() - start) << "s");
+
+  // Stay connected, discarding commands, until the viewer hangs up
+  socket.setBlocking(false);
+
+  try {
+    while (!shutdown) {
+      char buffer[4096];
+      if (socket.read(buffer, sizeof(buffer)) < 0) break;
+      sleep(0.1);
+    }
+  } catch (const Socket::EndOfStream &) {}
+}
@@ -0,0 +1,68 @@
+/******************************************************************************\
+
+                       This file is part of the FAHViewer.
+
+            The FAHViewer displays 3D views of Folding@home proteins.
+                    Copyright (c) 2016-2020, foldingathome.org
+                   Copyright (c) 2003-2016, Stanford University
+                               All rights reserved.
+
+       This program is free software; you can redistribute it and/or modify
+       it under the terms of the GNU General Public License as published by
+        the Free Software Foundation; either version 2 of the License, or
+                       (at your option) any later version.
+
+         This program is distributed in the hope that it will be useful,
+          but WITHOUT ANY WARRANTY; without even the implied warranty of
+          MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+                   GNU General Public License for more details.
+
+     You should have received a copy of the GNU General Public License along
+     with this program; if not, write to the Free Software Foundation, Inc.,
+           51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+                  For information regarding this software email:
+                                 Joseph Coffland
+                          joseph@cauldrondevelopment.com
+
+\******************************************************************************/
+
+
+#pragma once
+
+#include <cbang/net/IPAddress.h>
+
+#include <string>
+#include <atomic>
+#include <thread>
+
+
+namespace cb {class Socket;}
+
+
+namespace FAH {
+  /// Stands in for a FAHClient by serving a session recorded with
+  /// SessionWriter to whoever connects.  Data is sent at the recorded pace
+  /// scaled by speed, or as fast as possible when speed is zero.
+  class ReplayServer {
+    std::string path;
+    cb::IPAddress addr;
+    double speed;
+
+    std::thread thread;
+    std::atomic<bool> shutdown;
+
+  public:
+    ReplayServer(const std::string &path, const cb::IPAddress &addr,
+                 double speed = 1);
+    ~ReplayServer();
+
+    const cb::IPAddress &getAddress() const {return addr;}
+
+    void start();
+
+  protected:
+    void run();
+    void serve(cb::Socket &socket);
+  };
+}
@@ -0,0 +1,76 @@
+/******************************************************************************\
+
+                       This file is part of the FAHViewer.
+
+            The FAHViewer displays 3D views of Folding@home proteins.
+                    Copyright (c) 2016-2020, foldingathome.org
+                   Copyright (c) 2003-2016, Stanford University
+                               All rights reserved.
+
+       This program is free software; you can redistribute it and/or modify
+       it under the terms of the GNU General Public License as published by
+        the Free Software Foundation; either version 2 of the License, or
+                       (at your option) any later version.
+
+         This program is distributed in the hope that it will be useful,
+          but WITHOUT ANY WARRANTY; without even the implied warranty of
+          MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+                   GNU General Public License for more details.
+
+     You should have received a copy of the GNU General Public License along
+     with this program; if not, write to the Free Software Foundation, Inc.,
+           51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+                  For information regarding this software email:
+                                 Joseph Coffland
+                          joseph@cauldrondevelopment.com
+
+\******************************************************************************/
+
+
+#pragma once
+
+#include <atomic>
+#include <vector>
+
+
+namespace FAH {
+  /// A bounded, lock-free queue for exactly one producer and one consumer
+  /// thread.  Ownership of an element passes to the consumer on pop().
+  template <typename T>
+  class SPSCQueue {
+    std::vector<T> ring;
+    std::atomic<unsigned> head; ///< Next slot to read, owned by the consumer
+    std::atomic<unsigned> tail; ///< Next slot to write, owned by the producer
+
+  public:
+    SPSCQueue(unsigned capacity) : ring(capacity + 1), head(0), tail(0) {}
+
+    /// Called only by the producer.  @return false if the queue is full.
+    bool push(const T &value) {
+      unsigned t = tail.load(std::memory_order_relaxed);
+      unsigned next = (t + 1) % ring.size();
+      if (next == head.load(std::memory_order_acquire)) return false;
+
+      ring[t] = value;
+      tail.store(next, std::memory_order_release);
+      return true;
+    }
+
+    /// Called only by the consumer.  @return false if the queue is empty.
+    bool pop(T &value) {
+      unsigned h = head.load(std::memory_order_relaxed);
+      if (h == tail.load(std::memory_order_acquire)) return false;
+
+      value = ring[h];
+      ring[h] = T();
+      head.store((h + 1) % ring.size(), std::memory_order_release);
+      return true;
+    }
+
+    bool empty() const {
+      return head.load(std::memory_order_acquire) ==
+        tail.load(std::memory_order_acquire);
+    }
+  };
+}
@@ -0,0 +1,99 @@
+/******************************************************************************\
+
+                       This file is part of the FAHViewer.
+
+            The FAHViewer displays 3D views of Folding@home proteins.
+                    Copyright (c) 2016-2020, foldingathome.org
+                   Copyright (c) 2003-2016, Stanford University
+                               All rights reserved.
+
+       This program is free software; you can redistribute it and/or modify
+       it under the terms of the GNU General Public License as published by
+        the Free Software Foundation; either version 2 of the License, or
+                       (at your option) any later version.
+
+         This program is distributed in the hope that it will be useful,
+          but WITHOUT ANY WARRANTY; without even the implied warranty of
+          MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+                   GNU General Public License for more details.
+
+     You should have received a copy of the GNU General Public License along
+     with this program; if not, write to the Free Software Foundation, Inc.,
+           51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+                  For information regarding this software email:
+                                 Joseph Coffland
+                          joseph@cauldrondevelopment.com
+
+\******************************************************************************/
+
+
+#include "SpatialGrid.h"
+#include "Positions.h"
+
+#include <cmath>
+
+using namespace std;
+using namespace cb;
+using namespace FAH;
+
+
+void SpatialGrid::build(const Positions &positions, double cellSize) {
+  items.clear();
+  cellStart.clear();
+  dims[0] = dims[1] = dims[2] = 0;
+  if (positions.empty()) return;
+
+  bounds = Rectangle3D();
+  for (unsigned i = 0; i < positions.size(); i++) bounds.add(positions[i]);
+
+  // Grow cells until the grid is no larger than about two cells per point.
+  // This bounds memory when a few points are far from the rest.
+  const double maxCells = 2.0 * positions.size() + 27;
+  Vector3D extent = bounds.getDimensions();
+
+  while (true) {
+    double cells = 1;
+    for (unsigned i = 0; i < 3; i++)
+      cells *= floor(extent[i] / cellSize) + 1;
+
+    if (cells <= maxCells) break;
+    cellSize *= 2;
+  }
+
+  this->cellSize = cellSize;
+  for (unsigned i = 0; i < 3; i++)
+    dims[i] = (unsigned)floor(extent[i] / cellSize) + 1;
+
+  // Counting sort of point indices by cell
+  vector<unsigned> pointCell(positions.size());
+  cellStart.assign(getCellCount() + 1, 0);
+
+  for (unsigned i = 0; i < positions.size(); i++) {
+    int cell[3];
+    getCell(positions[i], cell);
+    pointCell[i] = (cell[0] * dims[1] + cell[1]) * dims[2] + cell[2];
+    cellStart[pointCell[i] + 1]++;
+  }
+
+  for (unsigned i = 0; i < getCellCount(); i++)
+    cellStart[i + 1] += cellStart[i];
+
+  vector<unsigned> fill(cellStart.begin(), cellStart.end() - 1);
+  items.resize(positions.size());
+  for (unsigned i = 0; i < positions.size(); i++)
+    items[fill[pointCell[i]]++] = i;
+}
+
+
+void SpatialGrid::getCell(const Vector3D &p, int cell[3]) const {
+  for (unsigned i = 0; i < 3; i++) {
+    double x = floor((p[i] - bounds.getMin()[i]) / cellSize);
+
+    // Clamp points far outside the grid so they have no neighbors
+    if (x < -1) x = -2;
+    else if (dims[i] < x) x = dims[i] + 1;
+
+    cell[i] = (int)x;
+  }
+}
@@ -0,0 +1,90 @@
+/******************************************************************************\
+
+                       This file is part of the FAHViewer.
+
+            The FAHViewer displays 3D views of Folding@home proteins.
+                    Copyright (c) 2016-2020, foldingathome.org
+                   Copyright (c) 2003-2016, Stanford University
+                               All rights reserved.
+
+       This program is free software; you can redistribute it and/or modify
+       it under the terms of the GNU General Public License as published by
+        the Free Software Foundation; either version 2 of the License, or
+                       (at your option) any later version.
+
+         This program is distributed in the hope that it will be useful,
+          but WITHOUT ANY WARRANTY; without even the implied warranty of
+          MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+                   GNU General Public License for more details.
+
+     You should have received a copy of the GNU General Public License along
+     with this program; if not, write to the Free Software Foundation, Inc.,
+           51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+                  For information regarding this software email:
+                                 Joseph Coffland
+                          joseph@cauldrondevelopment.com
+
+\******************************************************************************/
+
+
+#pragma once
+
+#include <cbang/geom/Vector.h>
+#include <cbang/geom/Rectangle.h>
+
+#include <vector>
+
+
+namespace FAH {
+  class Positions;
+
+  /// Uniform grid of cells used for fixed radius neighbor searches
+  class SpatialGrid {
+    double cellSize;
+    cb::Rectangle3D bounds;
+    unsigned dims[3];
+
+    std::vector<unsigned> cellStart; // Offset of each cell in items
+    std::vector<unsigned> items;     // Point indices sorted by cell
+
+  public:
+    SpatialGrid() : cellSize(1) {dims[0] = dims[1] = dims[2] = 0;}
+    SpatialGrid(const Positions &positions, double cellSize) :
+      cellSize(1) {build(positions, cellSize);}
+
+    double getCellSize() const {return cellSize;}
+    unsigned getCellCount() const {return dims[0] * dims[1] * dims[2];}
+
+    void build(const Positions &positions, double cellSize);
+
+    /// Call @param f with the index of every point in the cells surrounding
+    /// @param p.  Points within one cell size of @param p are always visited.
+    template <typename F>
+    void forEachNeighbor(const cb::Vector3D &p, F f) const {
+      if (items.empty()) return;
+
+      int cell[3];
+      getCell(p, cell);
+
+      for (int x = cell[0] - 1; x <= cell[0] + 1; x++) {
+        if (x < 0 || (int)dims[0] <= x) continue;
+
+        for (int y = cell[1] - 1; y <= cell[1] + 1; y++) {
+          if (y < 0 || (int)dims[1] <= y) continue;
+
+          for (int z = cell[2] - 1; z <= cell[2] + 1; z++) {
+            if (z < 0 || (int)dims[2] <= z) continue;
+
+            unsigned c = (x * dims[1] + y) * dims[2] + z;
+            for (unsigned i = cellStart[c]; i < cellStart[c + 1]; i++)
+              f(items[i]);
+          }
+        }
+      }
+    }
+
+  protected:
+    void getCell(const cb::Vector3D &p, int cell[3]) const;
+  };
+}
@@ -0,0 +1,176 @@
+/******************************************************************************\
+
+                       This file is part of the FAHViewer.
+
+            The FAHViewer displays 3D views of Folding@home proteins.
+                    Copyright (c) 2016-2020, foldingathome.org
+                   Copyright (c) 2003-2016, Stanford University
+                               All rights reserved.
+
+       This program is free software; you can redistribute it and/or modify
+       it under the terms of the GNU General Public License as published by
+        the Free Software Foundation; either version 2 of the License, or
+                       (at your option) any later version.
+
+         This program is distributed in the hope that it will be useful,
+          but WITHOUT ANY WARRANTY; without even the implied warranty of
+          MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+                   GNU General Public License for more details.
+
+     You should have received a copy of the GNU General Public License along
+     with this program; if not, write to the Free Software Foundation, Inc.,
+           51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+                  For information regarding this software email:
+                                 Joseph Coffland
+                          joseph@cauldrondevelopment.com
+
+\******************************************************************************/
+
+
+#include "Tile.h"
+
+#include "TestData.h"
+
+#include <cbang/String.h>
+#include <cbang/time/Time.h>
+
+using namespace std;
+using namespace cb;
+using namespace FAH;
+
+
+void Tile::setViewport(unsigned x, unsigned y, unsigned width,
+                       unsigned height) {
+  this->x = x;
+  this->y = y;
+  this->width = width;
+  this->height = height;
+}
+
+
+bool Tile::contains(unsigned x, unsigned y) const {
+  return this->x <= x && x < this->x + width &&
+    this->y <= y && y < this->y + height;
+}
+
+
+bool Tile::setSlot(unsigned slot) {
+  if (client.isNull() || !client->setSlot(slot)) return false;
+
+  connectTime = Time::now();
+  info = SimulationInfo();
+  trajectory->clear();
+  protein = 0;
+
+  return true;
+}
+
+
+void Tile::loadTestData() {
+  TestData::load(*trajectory);
+}
+
+
+string Tile::getStatus() const {
+  if (trajectory->empty() && !client.isNull()) {
+    if (info.coreType == 0x22) return "Incompat";
+    else if (client->hasLoadableSlot()) return "Loading";
+    else if (client->isConnected()) return "Awaiting";
+    else return "";
+
+  } else return info.project ? "Live" : "Demo";
+}
+
+
+string Tile::getFrameDescription(unsigned interpSteps) const {
+  unsigned total = getTotalFrames();
+  unsigned current = total ? 1 + currentFrame : 0;
+
+  if (interpSteps && 1 < total) {
+    total = total / (interpSteps + 1) + 1;
+    unsigned iCurrent = (current - 1) % (interpSteps + 1);
+    current = (current - 1) / (interpSteps + 1) + 1;
+    return String::printf("%d.%d of %d", current, iCurrent, total);
+  }
+
+  return String::printf("%d of %d", current, total);
+}
+
+
+bool Tile::update() {
+  bool redisplay = false;
+
+  // Update client connection
+  if (!client.isNull()) {
+    if (client->update()) redisplay = true;
+
+    // Load "Demo" protein after timeout
+    if (!client->isConnected()) {
+      if (!connectTime) connectTime = Time::now();
+      else if (trajectory->empty() && connectTime + 5 <= Time::now()) {
+        loadTestData();
+        redisplay = true;
+      }
+    }
+
+    // Update status
+    string status;
+    switch (client->getState()) {
+    case Client::STATE_WAITING: status = "Trying"; break;
+    case Client::STATE_CONNECTING: status = "Connecting"; break;
+    default: status = "Connected"; break;
+    }
+
+    if (connectionStatus != status) {
+      connectTime = 0;
+      connectionStatus = status;
+      redisplay = true;
+    }
+  }
+
+  if (trajectory->size() <= currentFrame) currentFrame = 0;
+
+  return redisplay;
+}
+
+
+bool Tile::animate(bool cycle, unsigned skip, double budget) {
+  if (trajectory->empty()) return false;
+
+  // A tile over its share of the frame time skips animation steps so that
+  // it does not also spend time interpolating every frame
+  if (budget && budget < drawTime && ++skipped < drawTime / budget)
+    return false;
+  skipped = 0;
+
+  bool redisplay = false;
+  unsigned size = trajectory->size();
+  unsigned oldFrame = currentFrame;
+
+  if (1 < size && cycle) {
+    // Advance frame
+    if (forward) {
+      currentFrame += skip;
+      if (size - 1 <= currentFrame) {
+        currentFrame = size - 1;
+        forward = false;
+      }
+
+    } else if (currentFrame <= skip) {
+      currentFrame = 0;
+      forward = true;
+
+    } else currentFrame -= skip;
+
+  } else currentFrame = size - 1;
+
+  if (oldFrame != currentFrame) {
+    protein = trajectory->getProtein(currentFrame);
+    redisplay = true;
+  }
+
+  if (protein.isNull()) protein = trajectory->getProtein(currentFrame);
+
+  return redisplay;
+}
@@ -0,0 +1,112 @@
+/******************************************************************************\
+
+                       This file is part of the FAHViewer.
+
+            The FAHViewer displays 3D views of Folding@home proteins.
+                    Copyright (c) 2016-2020, foldingathome.org
+                   Copyright (c) 2003-2016, Stanford University
+                               All rights reserved.
+
+       This program is free software; you can redistribute it and/or modify
+       it under the terms of the GNU General Public License as published by
+        the Free Software Foundation; either version 2 of the License, or
+                       (at your option) any later version.
+
+         This program is distributed in the hope that it will be useful,
+          but WITHOUT ANY WARRANTY; without even the implied warranty of
+          MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+                   GNU General Public License for more details.
+
+     You should have received a copy of the GNU General Public License along
+     with this program; if not, write to the Free Software Foundation, Inc.,
+           51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+                  For information regarding this software email:
+                                 Joseph Coffland
+                          joseph@cauldrondevelopment.com
+
+\******************************************************************************/
+
+
+#pragma once
+
+#include "Client.h"
+#include "Trajectory.h"
+#include "SimulationInfo.h"
+
+#include <cbang/SmartPointer.h>
+
+#include <string>
+#include <cstdint>
+
+
+namespace FAH {
+  /// A Client and Trajectory pair with its own animation state.  The
+  /// dashboard draws several tiles side by side in one window.
+  class Tile {
+    cb::SmartPointer<Client> client;
+    cb::SmartPointer<Trajectory> trajectory;
+    SimulationInfo info;
+    cb::SmartPointer<Protein> protein;
+
+    unsigned currentFrame = 0;
+    bool forward          = true;
+    uint64_t connectTime  = 0;
+    std::string connectionStatus = "None";
+
+    // Viewport in window pixels, origin at the bottom left
+    unsigned x      = 0;
+    unsigned y      = 0;
+    unsigned width  = 0;
+    unsigned height = 0;
+
+    double drawTime  = 0;
+    unsigned skipped = 0;
+
+  public:
+    Tile(const cb::SmartPointer<Trajectory> &trajectory) :
+      trajectory(trajectory) {}
+
+    const cb::SmartPointer<Client> &getClient() const {return client;}
+    void setClient(const cb::SmartPointer<Client> &client)
+    {this->client = client;}
+
+    Trajectory &getTrajectory() const {return *trajectory;}
+    void setTrajectory(const cb::SmartPointer<Trajectory> &trajectory)
+    {this->trajectory = trajectory;}
+
+    SimulationInfo &getSimulationInfo() {return info;}
+    const SimulationInfo &getSimulationInfo() const {return info;}
+
+    const cb::SmartPointer<Protein> &getProtein() const {return protein;}
+
+    unsigned getCurrentFrame() const {return currentFrame;}
+    unsigned getTotalFrames() const {return trajectory->size();}
+
+    const std::string &getConnectionStatus() const {return connectionStatus;}
+
+    void setViewport(unsigned x, unsigned y, unsigned width, unsigned height);
+    unsigned getX() const {return x;}
+    unsigned getY() const {return y;}
+    unsigned getWidth() const {return width;}
+    unsigned getHeight() const {return height;}
+    bool contains(unsigned x, unsigned y) const;
+
+    /// Seconds spent drawing this tile in the last frame
+    void setDrawTime(double drawTime) {this->drawTime = drawTime;}
+    double getDrawTime() const {return drawTime;}
+
+    bool setSlot(unsigned slot);
+    void loadTestData();
+
+    std::string getStatus() const;
+    std::string getFrameDescription(unsigned interpSteps) const;
+
+    /// Apply client updates, returns true if the tile should be redrawn
+    bool update();
+
+    /// Advance the animation by @param skip frames.  Tiles which took more
+    /// than @param budget seconds to draw advance less often.
+    bool animate(bool cycle, unsigned skip, double budget);
+  };
+}
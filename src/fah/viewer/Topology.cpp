@@ -29,10 +29,15 @@
 
 #include "Topology.h"
 #include "Positions.h"
+#include "SpatialGrid.h"
 
 #include <cbang/Exception.h>
+#include <cbang/String.h>
 #include <cbang/log/Logger.h>
 #include <cbang/json/JSON.h>
+#include <cbang/time/Timer.h>
+
+#include <algorithm>
 
 #include <limits>
 
@@ -62,53 +67,60 @@ void Topology::clear() {
 }
 
 
+double Topology::maxBondLength() const {
+  // Compare one atom of each element against the others
+  vector<const Atom *> elements;
+  for (unsigned i = 0; i < atoms.size(); i++) {
+    unsigned j;
+    for (j = 0; j < elements.size(); j++)
+      if (elements[j]->getNumber() == atoms[i].getNumber()) break;
+    if (j == elements.size()) elements.push_back(&atoms[i]);
+  }
+
+  double length = 0;
+  for (unsigned i = 0; i < elements.size(); i++)
+    for (unsigned j = i; j < elements.size(); j++)
+      length = max(length, elements[i]->averageBondLength(*elements[j]));
+
+  return length;
+}
+
+
 unsigned Topology::findBonds(vector<unsigned> &bondCounts,
-                             const Positions &positions) {
+                             const Positions &positions,
+                             const SpatialGrid &grid, bond_set_t &bondSet) {
   unsigned count = 0;
 
-  validate(positions);
-
   for (unsigned i = 0; i < atoms.size(); i++) {
     if (!bondCounts[i]) continue;
 
-    bool bondAdded = false;
+    // Find the closest unbonded neighbor, lowest index wins a tie
+    const Vector3D p = positions[i];
+    unsigned best = i;
     double minDist = numeric_limits<double>::max();
 
-    for (unsigned j = 0; j < atoms.size(); j++) {
-      if (i == j || !bondCounts[j]) continue; // Exclude self
-
-      double dist = positions.at(i).distance(positions.at(j));
+    grid.forEachNeighbor(p, [&] (unsigned j) {
+        if (i == j || !bondCounts[j]) return; // Exclude self
 
-      // Check if atoms are too far apart to have a bond
-      if (atoms.at(i).averageBondLength(atoms.at(j)) * 1.1 < dist) continue;
+        double dist = p.distance(positions[j]);
 
-      if (dist < minDist) {
-        // left < right
-        unsigned left = (i > j) ? j : i;
-        unsigned right = (i > j) ? i : j;
+        // Check if atoms are too far apart to have a bond
+        if (atoms[i].averageBondLength(atoms[j]) * 1.1 < dist) return;
+        if (minDist < dist || (dist == minDist && best < j)) return;
 
         // Ignore double and triple bonds
-        bool duplicate = false;
-        for (unsigned k = 0; k < bonds.size(); k++)
-          if (bonds.at(k).left == left && bonds.at(k).right == right) {
-            duplicate = true;
-            break;
-          }
-        if (duplicate) continue;
+        if (bondSet.count(bondKey(i, j))) return;
 
         minDist = dist;
+        best = j;
+      });
 
-        if (!bondAdded) {
-          bonds.push_back(Bond());
-          bondAdded = true;
-        }
+    if (best != i) {
+      // left < right
+      Bond bond(min(i, best), max(i, best));
 
-        bonds.at(bonds.size() - 1) = Bond(left, right); // Set bond
-      }
-    }
-
-    if (bondAdded) {
-      const Bond &bond = bonds.at(bonds.size() - 1);
+      bonds.push_back(bond);
+      bondSet.insert(bondKey(bond.left, bond.right));
       bondCounts[bond.left]--;
       bondCounts[bond.right]--;
       count += 2;
@@ -120,6 +132,7 @@ unsigned Topology::findBonds(vector<unsigned> &bondCounts,
 
 
 void Topology::findBonds(const Positions &positions) {
+  validate(positions);
   bonds.clear();
 
   // Set max bond counts
@@ -137,15 +150,24 @@ void Topology::findBonds(const Positions &positions) {
     total += bondCounts[i];
   }
 
+  // Only atoms closer than the longest possible bond need to be compared
+  double start = Timer::now();
+  SpatialGrid grid(positions, maxBondLength() * 1.1);
+  bond_set_t bondSet;
+
   unsigned remaining = total;
   unsigned lastRemaining = remaining;
   for (int i = 0; i < 100 && 0 < remaining; i++) {
-    remaining -= findBonds(bondCounts, positions);
+    remaining -= findBonds(bondCounts, positions, grid, bondSet);
 
     if (remaining == lastRemaining) break;
     lastRemaining = remaining;
   }
 
+  LOG_DEBUG(3, "Found " << bonds.size() << " bonds between " << atoms.size()
+            << " atoms in " << String::printf("%0.3f", Timer::now() - start)
+            << " sec");
+
   if (remaining)
     LOG_DEBUG(3, remaining << " of " << total << " bonds not found");
 }
@@ -196,3 +218,75 @@ void Topology::loadJSON(const JSON::Value &value, float scale) {
     LOG_DEBUG(3, "Read " << bonds.size() << " JSON bonds");
   }
 }
+
+
+void Topology::loadPyON(PyON::Decoder &decoder, float scale) {
+  clear();
+
+  unsigned atomCount = 0;
+  unsigned bondCount = 0;
+
+  decoder.expect('{');
+  if (!decoder.tryChar('}'))
+    do {
+      string key = decoder.parseKey();
+      decoder.expect(':');
+
+      if (key == "atoms") {
+        bool unknown = false;
+
+        decoder.expect('[');
+        if (!decoder.tryChar(']'))
+          do {
+            atomCount++;
+
+            // Atoms after the first UNKNOWN are counted but not kept
+            if (unknown) {decoder.skipValue(); continue;}
+
+            decoder.expect('[');
+            string type = decoder.parseString();
+            float values[4] = {0, 0, 0, 0};
+
+            for (unsigned i = 0; !decoder.nextItem(']'); i++)
+              if (i < 4) values[i] = decoder.parseNumber();
+              else decoder.skipValue();
+
+            if (type == "UNKNOWN") {unknown = true; continue;}
+
+            Atom atom;
+            atom.load(type, values[0], values[1] * scale, values[2],
+                      (unsigned)values[3]);
+            atoms.push_back(atom);
+          } while (!decoder.nextItem(']'));
+
+        LOG_DEBUG(3, "Read " << atomCount << " PyON atoms");
+
+      } else if (key == "bonds") {
+        decoder.expect('[');
+        if (!decoder.tryChar(']'))
+          do {
+            bondCount++;
+
+            decoder.expect('[');
+            double a = decoder.parseNumber();
+            decoder.expect(',');
+            double b = decoder.parseNumber();
+            decoder.tryChar(',');
+            decoder.expect(']');
+
+            // Bonds may precede atoms, range check after both are read
+            bonds.push_back(Bond((uint32_t)a, (uint32_t)b));
+          } while (!decoder.nextItem(']'));
+
+        LOG_DEBUG(3, "Read " << bondCount << " PyON bonds");
+
+      } else decoder.skipValue();
+    } while (!decoder.nextItem('}'));
+
+  // Drop bonds which reference atoms that were not kept
+  unsigned kept = atoms.size();
+  bonds.erase(remove_if(bonds.begin(), bonds.end(),
+                        [kept] (const Bond &bond) {
+                          return kept <= bond.left || kept <= bond.right;
+                        }), bonds.end());
+}
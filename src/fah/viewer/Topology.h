@@ -33,6 +33,7 @@
 #include "Bond.h"
 
 #include <fah/viewer/pyon/Object.h>
+#include <fah/viewer/pyon/Decoder.h>
 
 #include <cbang/SmartPointer.h>
 #include <cbang/geom/Rectangle.h>
@@ -40,15 +41,19 @@
 
 #include <iostream>
 #include <vector>
+#include <unordered_set>
+#include <cstdint>
 
 
 namespace FAH {
   class Positions;
+  class SpatialGrid;
 
   class Topology : public PyON::Object, public cb::TimeStamp {
   public:
     typedef std::vector<Atom> atoms_t;
     typedef std::vector<Bond> bonds_t;
+    typedef std::unordered_set<uint64_t> bond_set_t;
 
   protected:
     atoms_t atoms;
@@ -66,8 +71,7 @@ namespace FAH {
     void validate(const Positions &positions) const;
     void clear();
 
-    unsigned findBonds(std::vector<unsigned> &bondCounts,
-                       const Positions &positions);
+    double maxBondLength() const;
     void findBonds(const Positions &positions);
 
     // From PyONObject
@@ -76,5 +80,16 @@ namespace FAH {
     void loadJSON(const cb::JSON::Value &value) {loadJSON(value, 1);}
 
     void loadJSON(const cb::JSON::Value &value, float scale);
+
+    /// Decode a PyON topology value without building a JSON DOM
+    void loadPyON(PyON::Decoder &decoder, float scale = 1);
+
+  protected:
+    static uint64_t bondKey(uint32_t a, uint32_t b)
+    {return a < b ? ((uint64_t)a << 32 | b) : ((uint64_t)b << 32 | a);}
+
+    unsigned findBonds(std::vector<unsigned> &bondCounts,
+                       const Positions &positions, const SpatialGrid &grid,
+                       bond_set_t &bondSet);
   };
 }
@@ -30,34 +30,113 @@
 #include "Trajectory.h"
 
 #include <fah/viewer/io/XYZReader.h>
+#include <fah/viewer/io/SessionReader.h>
+#include <fah/viewer/pyon/Header.h>
+#include <fah/viewer/pyon/Decoder.h>
 
 #include <cbang/Exception.h>
 #include <cbang/Math.h>
 #include <cbang/String.h>
+#include <cbang/Catch.h>
+#include <cbang/iostream/ArrayDevice.h>
 #include <cbang/log/Logger.h>
-#include <cbang/util/Random.h>
+#include <cbang/time/Timer.h>
 #include <cbang/json/JSON.h>
+#include <cbang/os/SystemUtilities.h>
+
+#include <algorithm>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
 
 using namespace std;
 using namespace cb;
 using namespace FAH;
 
 
-SmartPointer<Protein> Trajectory::getProtein(unsigned i) {
-  SmartPointer<Protein> protein = new Protein(topology, at(i));
+SmartPointer<Positions> Trajectory::getKeyframe(unsigned i) {
+  SmartPointer<Positions> &p = Super_T::at(i);
+
+  if (p.isNull() && !cache.isNull()) {
+    p = new Positions;
+    cache->readFrame(i, *p);
+
+    bytes += p->getMemoryUsage();
+    loaded.push_back(i);
+    evict();
+  }
+
+  return p;
+}
+
+
+SmartPointer<Positions> Trajectory::getPositions(unsigned i) {
+  unsigned key = i / (interpolate + 1);
+  unsigned step = i % (interpolate + 1);
+
+  if (!step) return getKeyframe(key);
+
+  // Linear interpolation between the keyframes.  Held by reference count
+  // since loading the second may unload the first.
+  SmartPointer<Positions> p1 = getKeyframe(key);
+  SmartPointer<Positions> p2 = getKeyframe(key + 1);
+  double t = (double)step / (interpolate + 1);
+
+  if (scratch.isNull()) scratch = new Positions;
+  scratch->interpolate(*p1, *p2, t);
+
+  return scratch;
+}
+
+
+const SmartPointer<Protein> &Trajectory::getProtein(unsigned i) {
+  if (protein.isNull()) protein = new Protein(topology, 0);
+
+  protein->setTopology(topology);
+  protein->setPositions(getPositions(i));
 
-  // Get maximum radius to avoid zooming effect
-  double radius = 0;
-  for (unsigned i = 0; i < size(); i++)
-    if (radius < at(i)->getRadius()) radius = at(i)->getRadius();
-  protein->setRadius(radius);
+  // Use the maximum radius to avoid zooming effect.  Interpolated frames
+  // never extend past the keyframes on either side of them.
+  protein->setRadius(maxRadius);
 
   return protein;
 }
 
 
-void Trajectory::add(const SmartPointer<Positions> &positions) {
+void Trajectory::clear() {
+  topology = new Topology;
+  Super_T::clear();
+  cache.release();
+  loaded.clear();
+  bytes = 0;
+  maxRadius = 0;
+}
+
+
+void Trajectory::add(const SmartPointer<Positions> &positions,
+                     bool centered) {
+  if (positions->empty()) THROW("Not adding empty positions");
+
+  shiftIntoBox(*positions, offsets);
+  if (center && !centered) positions->translateToCenterOfMass();
+
+  double rmsd = this->rmsd;
+  if (align && !empty())
+    rmsd = alignTo(*positions, *getKeyframe(Super_T::size() - 1),
+                   topology->getAtoms(), massWeighted);
+
+  if (!topology.isNull() && topology->getBonds().empty())
+    topology->findBonds(*positions);
+
+  addProcessed(positions, rmsd);
+}
+
+
+void Trajectory::addProcessed(const SmartPointer<Positions> &positions,
+                              double rmsd) {
   if (positions->empty()) THROW("Not adding empty positions");
+  detachCache();
 
   if (!topology->isEmpty()) {
     if (positions->size() != topology->getAtoms().size())
@@ -66,33 +145,287 @@ void Trajectory::add(const SmartPointer<Positions> &positions) {
                   << topology->getAtoms().size());
 
   } else if (!empty()) {
-    SmartPointer<Positions> last = back();
+    SmartPointer<Positions> last = getKeyframe(Super_T::size() - 1);
     if (positions->size() != last->size())
       LOG_WARNING("Size of positions " << positions->size()
                   << " does not match trajectory " << last->size());
   }
 
-  shiftIntoBox(*positions);
-  if (center) positions->translateToCenterOfMass();
-  if (align) alignToLast(*positions);
-  if (interpolate) interpolateTo(*positions);
+  push_back(positions);
+  bytes += positions->getMemoryUsage();
+  maxRadius = max(maxRadius, positions->getRadius());
+  this->rmsd = rmsd;
 
-  if (!topology.isNull() && topology->getBonds().empty())
-    topology->findBonds(*positions);
+  while (maxBytes && maxBytes < bytes && 2 < Super_T::size())
+    if (!decimate()) break;
+}
 
-  push_back(positions);
+
+void Trajectory::add(Input &input) {
+  if (!input.topology.isNull()) setTopology(input.topology);
+
+  for (unsigned i = 0; i < input.frames.size(); i++)
+    add(input.frames[i], input.centered);
+}
+
+
+void Trajectory::read(const string &filename) {
+  string ext = SystemUtilities::extension(filename);
+
+  if (ext == "fvt") readCache(filename);
+  else if (ext == "session") readSession(filename);
+  else {
+    Input input;
+    if (!parse(filename, input))
+      THROW("Input file with unknown extension '" << filename << "'");
+    add(input);
+  }
+}
+
+
+void Trajectory::read(const vector<string> &filenames, unsigned threads) {
+  if (!threads) threads = max(1U, std::thread::hardware_concurrency());
+  threads = min(threads, (unsigned)filenames.size());
+
+  if (threads < 2) {
+    for (unsigned i = 0; i < filenames.size(); i++)
+      try {
+        read(filenames[i]);
+      } CATCH_ERROR;
+    return;
+  }
+
+  enum {PENDING, PARSED, SERIAL, FAILED};
+  vector<Input> inputs(filenames.size());
+  vector<int> states(filenames.size(), PENDING);
+  mutex lock;
+  condition_variable ready;
+  atomic<unsigned> next(0);
+  unsigned consumed = 0; ///< Inputs the ordered stage is done with
+  const unsigned lookahead = 2 * threads;
+  bool stop = false;
+  bool centerInputs = center;
+
+  // Parsing, centering and bond finding do not depend on the other inputs
+  auto worker = [&] () {
+    while (true) {
+      unsigned i = next++;
+      if (filenames.size() <= i) break;
+
+      // Keep only a few inputs resident ahead of the ordered stage
+      {
+        unique_lock<mutex> guard(lock);
+        ready.wait(guard, [&] () {return stop || i < consumed + lookahead;});
+        if (stop) break;
+      }
+
+      int state = FAILED;
+      Input &input = inputs[i];
+
+      try {
+        if (parse(filenames[i], input)) {
+          state = PARSED;
+
+          // Centering must follow unwrapping of periodic boxes
+          bool boxed = false;
+          for (unsigned j = 0; j < input.frames.size(); j++)
+            boxed |= !input.frames[j]->getBox().empty();
+
+          if (centerInputs && !boxed) {
+            for (unsigned j = 0; j < input.frames.size(); j++)
+              input.frames[j]->translateToCenterOfMass();
+            input.centered = true;
+          }
+
+          // Bonds only depend on distances, which alignment preserves
+          const SmartPointer<Topology> &topology = input.topology;
+          if (!boxed && !topology.isNull() && !input.frames.empty() &&
+              topology->getBonds().empty())
+            topology->findBonds(*input.frames[0]);
+
+        } else state = SERIAL;
+      } CATCH_ERROR;
+
+      lock_guard<mutex> guard(lock);
+      states[i] = state;
+      ready.notify_all();
+    }
+  };
+
+  // Joins the workers however this function is left
+  struct Pool {
+    vector<std::thread> threads;
+    mutex &lock;
+    condition_variable &ready;
+    bool &stop;
+
+    ~Pool() {
+      {
+        lock_guard<mutex> guard(lock);
+        stop = true;
+        ready.notify_all();
+      }
+
+      for (unsigned i = 0; i < threads.size(); i++) threads[i].join();
+    }
+  } pool = {vector<std::thread>(), lock, ready, stop};
+
+  for (unsigned i = 0; i < threads; i++)
+    pool.threads.push_back(std::thread(worker));
+
+  // Unwrapping, alignment and decimation run in order as inputs arrive
+  for (unsigned i = 0; i < filenames.size(); i++) {
+    int state;
+    {
+      unique_lock<mutex> guard(lock);
+      ready.wait(guard, [&] () {return states[i] != PENDING;});
+      state = states[i];
+    }
+
+    try {
+      if (state == PARSED) add(inputs[i]);
+      else if (state == SERIAL) read(filenames[i]);
+    } CATCH_ERROR;
+
+    inputs[i] = Input(); // Free the parsed frames
+
+    lock_guard<mutex> guard(lock);
+    consumed = i + 1;
+    ready.notify_all();
+  }
 }
 
 
 void Trajectory::readXYZ(const string &filename) {
-  SmartPointer<Positions> positions = new Positions;
-  XYZReader(filename).read(*positions, topology.get());
-  topology->setTS();
-  add(positions);
+  Input input;
+  parseXYZ(filename, input);
+  add(input);
 }
 
 
 void Trajectory::readJSON(const string &filename) {
+  Input input;
+  parseJSON(filename, input);
+  add(input);
+}
+
+
+void Trajectory::readCache(const string &filename) {
+  if (!empty()) THROW("Cannot read a trajectory cache into a non-empty "
+                      "trajectory");
+
+  LOG_DEBUG(3, "Reading trajectory cache " << filename);
+
+  SmartPointer<TrajectoryCache> cache = new TrajectoryCache(filename);
+  if (!cache->getFrameCount()) THROW(filename << " has no frames");
+
+  topology = new Topology;
+  cache->readTopology(*topology);
+
+  // Frames are loaded on first access
+  Super_T::resize(cache->getFrameCount());
+  for (unsigned i = 0; i < cache->getFrameCount(); i++)
+    maxRadius = max(maxRadius, cache->getRadius(i));
+
+  this->cache = cache;
+}
+
+
+void Trajectory::readSession(const string &filename) {
+  LOG_DEBUG(3, "Reading session " << filename);
+
+  // Reassemble the stream the client received
+  SessionReader reader(filename);
+  string stream;
+  string data;
+  double time;
+  while (reader.read(time, data)) stream += data;
+
+  // Replay the bulk data messages, framed as Client frames them
+  unsigned messages = 0;
+  size_t offset = 0;
+
+  while (true) {
+    size_t header = stream.find("\nPyON ", offset);
+    if (header == string::npos) break;
+    header++;
+
+    size_t body = stream.find('\n', header);
+    if (body == string::npos) break;
+    body++;
+
+    size_t bodyEnd = stream.find("\n---\n", body);
+    if (bodyEnd == string::npos) break;
+    offset = bodyEnd + 4; // Keep the newline, it starts the next header
+
+    const char *data = stream.data();
+    PyON::Header pyonHeader;
+    ArrayStream<const char> headerStream(data + header, body - header);
+    headerStream >> pyonHeader;
+    if (!pyonHeader.isValid()) continue;
+    const string &type = pyonHeader.getType();
+
+    try {
+      PyON::Decoder decoder(data + body, data + bodyEnd);
+
+      if (type == "topology") {
+        SmartPointer<Topology> topology = new Topology;
+        topology->loadPyON(decoder);
+        topology->setTS();
+        clear();
+        setTopology(topology);
+        messages++;
+
+      } else if (type == "positions") {
+        SmartPointer<Positions> positions = new Positions;
+        positions->loadPyON(decoder);
+        add(positions);
+        messages++;
+      }
+    } CATCH_ERROR;
+  }
+
+  LOG_INFO(1, "Read " << messages << " trajectory messages from " << filename);
+}
+
+
+bool Trajectory::parse(const string &filename, Input &input) {
+  string ext = SystemUtilities::extension(filename);
+
+  if (ext == "xyz") parseXYZ(filename, input);
+  else if (ext == "json") parseJSON(filename, input);
+  else return false;
+
+  return true;
+}
+
+
+void Trajectory::parseXYZ(const string &filename, Input &input) {
+  XYZReader reader(filename);
+  double start = Timer::now();
+
+  // Only the first frame carries the topology
+  input.topology = new Topology;
+
+  while (true) {
+    SmartPointer<Positions> positions = new Positions;
+    bool first = input.frames.empty();
+    if (!reader.read(*positions, first ? input.topology.get() : 0)) break;
+    input.frames.push_back(positions);
+  }
+
+  if (input.frames.empty()) THROW("Failed to read XYZ " << filename);
+  input.topology->setTS();
+
+  double delta = Timer::now() - start;
+  LOG_DEBUG(3, "Read " << input.frames.size() << " XYZ frames from "
+            << filename << " at "
+            << (delta ? reader.getLength() / delta / (1 << 20) : 0)
+            << "MiB/sec");
+}
+
+
+void Trajectory::parseJSON(const string &filename, Input &input) {
   LOG_DEBUG(3, "Reading JSON file " << filename);
 
   JSON::Reader reader(filename);
@@ -111,18 +444,19 @@ void Trajectory::readJSON(const string &filename) {
 
     // Topology
     if (data->has("atoms")) {
-      topology->loadJSON(*data, scale);
-      topology->setTS();
+      input.topology = new Topology;
+      input.topology->loadJSON(*data, scale);
+      input.topology->setTS();
     }
 
     // Positions
     if (data->has("positions")) {
       auto &list = data->getList("positions");
       for (unsigned i = 0; i < list.size(); i++)
-        add(new Positions(list.getList(i), scale));
+        input.frames.push_back(new Positions(list.getList(i), scale));
     }
 
-  } else add(new Positions(*data, 10));
+  } else input.frames.push_back(new Positions(*data, 10));
 }
 
 
@@ -131,18 +465,77 @@ void Trajectory::ensureTopology() {
   if (empty()) THROW("Cannot create topology with no positions");
 
   Atom atom("C");
-  for (unsigned i = 0; i < front()->size(); i++) topology->add(atom);
+  unsigned atoms = getKeyframe(0)->size();
+  for (unsigned i = 0; i < atoms; i++) topology->add(atom);
 }
 
 
 void Trajectory::recomputeBonds() {
   if (empty()) return;
   ensureTopology();
-  topology->findBonds(*at(0));
+  topology->findBonds(*getKeyframe(0));
 }
 
 
-void Trajectory::shiftIntoBox(Positions &p) {
+bool Trajectory::decimate() {
+  // Drop every other keyframe from the older half of the trajectory.  Done
+  // repeatedly, the oldest keyframes end up every 2^k-th of the originals
+  // while the most recent ones are kept intact.
+  unsigned count = Super_T::size();
+  if (count < 3) return false;
+
+  // Always cover keyframe 1 so every pass drops at least one keyframe and
+  // the first and last are never dropped
+  unsigned older = max(2U, count / 2);
+  unsigned j = 0;
+
+  for (unsigned i = 0; i < count; i++)
+    if (older <= i || !(i & 1)) Super_T::at(j++) = Super_T::at(i);
+    else bytes -= Super_T::at(i)->getMemoryUsage();
+
+  Super_T::resize(j);
+  decimations++;
+
+  // Evicted keyframes may have held the maximum radius
+  maxRadius = 0;
+  for (unsigned i = 0; i < j; i++)
+    maxRadius = max(maxRadius, Super_T::at(i)->getRadius());
+
+  LOG_DEBUG(3, "Decimated trajectory from " << count << " to " << j
+            << " keyframes, " << bytes / (1 << 20) << "MiB resident");
+
+  return j < count;
+}
+
+
+void Trajectory::evict() {
+  // Unload the least recently loaded keyframes, they can be reloaded from
+  // the cache at any time
+  while (maxBytes && maxBytes < bytes && 2 < loaded.size()) {
+    SmartPointer<Positions> &p = Super_T::at(loaded.front());
+    bytes -= p->getMemoryUsage();
+    p.release();
+    loaded.pop_front();
+  }
+}
+
+
+void Trajectory::detachCache() {
+  if (cache.isNull()) return;
+
+  // Appending frames, which may be centered or aligned against the cached
+  // ones, turns the trajectory into an ordinary one
+  uint64_t maxBytes = this->maxBytes;
+  this->maxBytes = 0;
+  for (unsigned i = 0; i < Super_T::size(); i++) getKeyframe(i);
+  this->maxBytes = maxBytes;
+
+  cache.release();
+  loaded.clear();
+}
+
+
+void Trajectory::shiftIntoBox(Positions &p, vector<Vector3D> &offsets) {
   if (p.getBox().empty()) return;
   const vector<Vector3D> &box = p.getBox();
 
@@ -154,97 +547,160 @@ void Trajectory::shiftIntoBox(Positions &p) {
   //  trajectory.
 
   for (unsigned n = 1; n < p.size(); n++) {
-    Vector3D orig = p[n];
-    p[n] += offsets[n];
+    const Vector3D orig = p[n];
+    const Vector3D prev = p[n - 1];
+    Vector3D v = orig + offsets[n];
 
     for (int m = 2; 0 <= m; m--) {
       double dist;
 
-      while (0.75 * box[m][m] < fabs(dist = p[n][m] - p[n - 1][m])) {
+      while (0.75 * box[m][m] < fabs(dist = v[m] - prev[m])) {
         if (10 * box[m][m] < fabs(dist)) break; // Ignore unreasonable
-        if (0 < dist) for (int d = 0; d <= m; d++) p[n][d] -= box[m][d];
-        else for (int d = 0; d <= m; d++) p[n][d] += box[m][d];
+        if (0 < dist) for (int d = 0; d <= m; d++) v[d] -= box[m][d];
+        else for (int d = 0; d <= m; d++) v[d] += box[m][d];
       }
     }
 
-    offsets[n] = p[n] - orig;
+    p.set(n, v);
+    offsets[n] = v - orig;
 
-    LOG_DEBUG(5, "SHIFT: " << n << ' ' << p[n] << ' ' << offsets[n]);
+    LOG_DEBUG(5, "SHIFT: " << n << ' ' << v << ' ' << offsets[n]);
   }
 }
 
 
-static double alignment(const Positions &p1, const Positions &p2) {
-  // Computes a metric of how aligned the two sets of positions are
-  double d = 0;
-
-  // Only consider every 8th position for better performance
-  for (unsigned i = 1; i < p1.size(); i += 8)
-    d += p1[i].distanceSquared(p2[i]);
-
-  return sqrt(d) * 8 / p1.size();
+static void jacobiEigen(double a[4][4], double v[4][4]) {
+  // Cyclic Jacobi eigenvalue algorithm for a symmetric 4x4 matrix.  On return
+  // the diagonal of a holds the eigenvalues and the columns of v the vectors.
+  for (int i = 0; i < 4; i++)
+    for (int j = 0; j < 4; j++)
+      v[i][j] = i == j;
+
+  for (int sweep = 0; sweep < 50; sweep++) {
+    double off = 0;
+    for (int p = 0; p < 3; p++)
+      for (int q = p + 1; q < 4; q++)
+        off += a[p][q] * a[p][q];
+    if (off < 1e-22) return;
+
+    for (int p = 0; p < 3; p++)
+      for (int q = p + 1; q < 4; q++) {
+        if (!a[p][q]) continue;
+
+        double theta = (a[q][q] - a[p][p]) / (2 * a[p][q]);
+        double t = (theta < 0 ? -1 : 1) /
+          (fabs(theta) + sqrt(theta * theta + 1));
+        double c = 1 / sqrt(t * t + 1);
+        double s = t * c;
+
+        for (int k = 0; k < 4; k++) {
+          double akp = a[k][p];
+          double akq = a[k][q];
+          a[k][p] = c * akp - s * akq;
+          a[k][q] = s * akp + c * akq;
+        }
+
+        for (int k = 0; k < 4; k++) {
+          double apk = a[p][k];
+          double aqk = a[q][k];
+          a[p][k] = c * apk - s * aqk;
+          a[q][k] = s * apk + c * aqk;
+        }
+
+        for (int k = 0; k < 4; k++) {
+          double vkp = v[k][p];
+          double vkq = v[k][q];
+          v[k][p] = c * vkp - s * vkq;
+          v[k][q] = s * vkp + c * vkq;
+        }
+      }
+  }
 }
 
 
-void Trajectory::alignToLast(Positions &p) {
-  // This function uses a random search, similar to simulated annealing, to
-  // find a rotation of the current positions which is close to the previous.
-  // This helps stabilize the view of the protein and improve interpolation
-  // between frames.
+double Trajectory::alignTo(Positions &p, const Positions &last,
+                           const Topology::atoms_t &atoms, bool massWeighted) {
+  // Rotates the current positions about the origin to minimize the RMSD to
+  // the previous positions.  This helps stabilize the view of the protein and
+  // improve interpolation between frames.  The optimal rotation is found in
+  // closed form with Horn's quaternion method.  See:
+  //   Horn, B. K. P. "Closed-form solution of absolute orientation using unit
+  //   quaternions." JOSA A 4.4 (1987): 629-642.
 
-  if (empty() || p.empty()) return;
+  if (p.empty()) return 0;
 
-  const Positions &last = *back();
+  unsigned n = min(p.size(), last.size());
+  bool weighted = massWeighted && n <= atoms.size();
 
-  double align = alignment(p, last);
-  double start = align;
-  double angle = 2 * M_PI;
-  unsigned rounds = 64;
-  const double magicStoppingPoint = 0.3;
-  double rate = pow(4.0 / 360.0, 1.0 / rounds); // Within 4 degrees
+  // Weighted covariance of current and previous positions
+  double S[3][3] = {{0, 0, 0}, {0, 0, 0}, {0, 0, 0}};
+  double e0 = 0;
+  double totalWeight = 0;
 
-  for (unsigned j = 0; magicStoppingPoint < align && j < rounds; j++) {
-    for (unsigned l = 0; l < 2; l++) {
-      uint8_t r = Random::instance().rand<uint8_t>();
-      Vector3D v(!(r & 1), !(r & 2), !(r & 4));
-      AxisAngleD a(angle * (l ? -1 : 1), v.normalize());
+  for (unsigned i = 0; i < n; i++) {
+    const Vector3D a = p[i];
+    const Vector3D b = last[i];
+    double w = weighted ? atoms[i].getMass() : 1;
 
-      // Rotate
-      Positions tmp(p);
-      for (unsigned i = 0; i < p.size(); i++)
-        tmp[i] = a.rotate(tmp[i]);
+    for (int j = 0; j < 3; j++)
+      for (int k = 0; k < 3; k++)
+        S[j][k] += w * a[j] * b[k];
 
-      // Recheck
-      double newAlign = alignment(tmp, last);
-      if (newAlign < align) {
-        // Accept
-        align = newAlign;
-        p = tmp;
-      }
-    }
-
-    angle *= rate;
+    e0 += w * (a.lengthSquared() + b.lengthSquared());
+    totalWeight += w;
   }
 
-  if (magicStoppingPoint <= start)
-    LOG_DEBUG(3, "Alignment start=" << start << " end=" << align << " improved "
-              << String::printf("%0.2f%%", (1.0 - align / start) * 100));
-}
-
-
-void Trajectory::interpolateTo(const Positions &p2) {
-  if (empty()) return;
+  if (totalWeight <= 0) return 0;
+
+  // The eigenvector of the largest eigenvalue of this matrix is the rotation
+  double N[4][4] = {
+    {S[0][0] + S[1][1] + S[2][2], S[1][2] - S[2][1],
+     S[2][0] - S[0][2], S[0][1] - S[1][0]},
+    {S[1][2] - S[2][1], S[0][0] - S[1][1] - S[2][2],
+     S[0][1] + S[1][0], S[2][0] + S[0][2]},
+    {S[2][0] - S[0][2], S[0][1] + S[1][0],
+     -S[0][0] + S[1][1] - S[2][2], S[1][2] + S[2][1]},
+    {S[0][1] - S[1][0], S[2][0] + S[0][2],
+     S[1][2] + S[2][1], -S[0][0] - S[1][1] + S[2][2]},
+  };
+
+  double trace = N[0][0];
+  double V[4][4];
+  jacobiEigen(N, V);
+
+  int best = 0;
+  for (int i = 1; i < 4; i++)
+    if (N[best][best] < N[i][i]) best = i;
+
+  double w = V[0][best];
+  double x = V[1][best];
+  double y = V[2][best];
+  double z = V[3][best];
+
+  double start = sqrt(max(0.0, e0 - 2 * trace) / totalWeight);
+  double rmsd = sqrt(max(0.0, e0 - 2 * N[best][best]) / totalWeight);
+
+  // Rotate
+  const double R[3][3] = {
+    {1 - 2 * (y * y + z * z), 2 * (x * y - w * z), 2 * (x * z + w * y)},
+    {2 * (x * y + w * z), 1 - 2 * (x * x + z * z), 2 * (y * z - w * x)},
+    {2 * (x * z - w * y), 2 * (y * z + w * x), 1 - 2 * (x * x + y * y)},
+  };
+
+  float *px = p.getX();
+  float *py = p.getY();
+  float *pz = p.getZ();
+
+  for (unsigned i = 0; i < p.size(); i++) {
+    double vx = px[i], vy = py[i], vz = pz[i];
+    px[i] = R[0][0] * vx + R[0][1] * vy + R[0][2] * vz;
+    py[i] = R[1][0] * vx + R[1][1] * vy + R[1][2] * vz;
+    pz[i] = R[2][0] * vx + R[2][1] * vy + R[2][2] * vz;
+  }
 
-  // Linear interpolation between the positions
-  const Positions &p1 = *back();
-  for (unsigned i = 0; i < interpolate; i++) {
-    SmartPointer<Positions> step = new Positions(p1);
+  p.init();
 
-    double t = (double)(i + 1) / (interpolate + 1);
-    for (unsigned i = 0; i < p1.size(); i++)
-      step->at(i) = p1[i].intersect(p2[i], t);
+  LOG_DEBUG(3, "Alignment RMSD start=" << start << " end=" << rmsd);
 
-    step->init();
-    push_back(step);
-  }
+  return rmsd;
 }
@@ -33,22 +33,48 @@
 #include "Topology.h"
 #include "Positions.h"
 
+#include <fah/viewer/io/TrajectoryCache.h>
+
 #include <cbang/SmartPointer.h>
 #include <cbang/geom/Quaternion.h>
 
+#include <string>
 #include <vector>
+#include <deque>
+#include <cstdint>
 
 
 namespace FAH {
+  /// Holds the keyframes of a trajectory.  When interpolation is enabled
+  /// the frames between keyframes are computed on demand.
   class Trajectory : protected std::vector<cb::SmartPointer<Positions> > {
     typedef std::vector<cb::SmartPointer<Positions> > Super_T;
 
     cb::SmartPointer<Topology> topology;
-    Positions offsets;
+    cb::SmartPointer<Positions> scratch;
+    cb::SmartPointer<Protein> protein;
+    std::vector<cb::Vector3D> offsets;
     cb::QuaternionD rotation;
     bool center;
     bool align;
+    bool massWeighted = false;
     unsigned interpolate;
+    double rmsd = 0;
+    double maxRadius = 0;
+
+    uint64_t maxBytes = 0;
+    uint64_t bytes = 0;
+    unsigned decimations = 0;
+
+    cb::SmartPointer<TrajectoryCache> cache;
+    std::deque<unsigned> loaded;
+
+    /// The contents of an input file before it is added
+    struct Input {
+      cb::SmartPointer<Topology> topology;
+      std::vector<cb::SmartPointer<Positions> > frames;
+      bool centered = false;
+    };
 
   public:
     Trajectory(bool center = true, bool align = false, unsigned interpolate = 0,
@@ -56,32 +82,96 @@ namespace FAH {
       topology(topology), center(center), align(align),
       interpolate(interpolate) {}
 
+    void setMassWeighted(bool massWeighted)
+    {this->massWeighted = massWeighted;}
+    bool getMassWeighted() const {return massWeighted;}
+
+    /// RMSD between the last added frame and the one before it after alignment
+    double getAlignmentRMSD() const {return rmsd;}
+
+    /// Limit the memory used by keyframes, zero for no limit.  When the
+    /// limit is exceeded older keyframes are thinned out, or for a trajectory
+    /// read from a cache, the least recently loaded ones are unloaded.
+    void setMaxBytes(uint64_t maxBytes) {this->maxBytes = maxBytes;}
+    uint64_t getMaxBytes() const {return maxBytes;}
+
+    unsigned getResidentFrames() const
+    {return cache.isNull() ? Super_T::size() : loaded.size();}
+    uint64_t getResidentBytes() const {return bytes;}
+    unsigned getDecimations() const {return decimations;}
+
     void setTopology(const cb::SmartPointer<Topology> &topology)
     {this->topology = topology;}
     const cb::SmartPointer<Topology> &getTopology() const {return topology;}
 
-    cb::SmartPointer<Protein> getProtein(unsigned i);
-
-    void clear() {topology = new Topology; Super_T::clear();}
-    void add(const cb::SmartPointer<Positions> &positions);
+    bool getCenter() const {return center;}
+    bool getAlign() const {return align;}
+    unsigned getInterpolation() const {return interpolate;}
+
+    /// @return the number of frames including interpolated ones
+    unsigned size() const {
+      if (Super_T::empty()) return 0;
+      return (Super_T::size() - 1) * (interpolate + 1) + 1;
+    }
+    bool empty() const {return Super_T::empty();}
+
+    unsigned getKeyframeCount() const {return Super_T::size();}
+    /// Keyframes of a cached trajectory are loaded on demand
+    cb::SmartPointer<Positions> getKeyframe(unsigned i);
+
+    /// Interpolated frames are computed into a buffer which is reused by the
+    /// next call.
+    cb::SmartPointer<Positions> getPositions(unsigned i);
+
+    /// The returned Protein is reused by the next call
+    const cb::SmartPointer<Protein> &getProtein(unsigned i);
+
+    /// @return the largest radius of any keyframe
+    double getMaxRadius() const {return maxRadius;}
+
+    void clear();
+    void add(const cb::SmartPointer<Positions> &positions)
+    {add(positions, false);}
+    /// Add a keyframe which was already unwrapped, centered and aligned,
+    /// see TrajectoryPipeline
+    void addProcessed(const cb::SmartPointer<Positions> &positions,
+                      double rmsd);
+
+    /// Read a file by its extension
+    void read(const std::string &filename);
+    /// XYZ and JSON files are parsed and centered on @param threads threads,
+    /// zero for one per core, while frames are added in order as they become
+    /// available.  Other files are read in order.
+    void read(const std::vector<std::string> &filenames, unsigned threads = 0);
 
     void readXYZ(const std::string &filename);
     void readJSON(const std::string &filename);
+    void readCache(const std::string &filename);
+    void readSession(const std::string &filename);
 
     void ensureTopology();
     void recomputeBonds();
 
-    // From Super_T
-    using Super_T::empty;
-    using Super_T::at;
-    using Super_T::operator[];
-    using Super_T::size;
-    using Super_T::front;
-    using Super_T::back;
+    /// Undo jumps across the periodic box, accumulating per atom @param offsets
+    /// over the trajectory
+    static void shiftIntoBox(Positions &p,
+                             std::vector<cb::Vector3D> &offsets);
+    /// Rotate @param p to minimize the RMSD to @param last
+    /// @return the RMSD after alignment
+    static double alignTo(Positions &p, const Positions &last,
+                          const Topology::atoms_t &atoms, bool massWeighted);
 
   protected:
-    void shiftIntoBox(Positions &p);
-    void alignToLast(Positions &p);
-    void interpolateTo(const Positions &p);
+    void add(const cb::SmartPointer<Positions> &positions, bool centered);
+    void add(Input &input);
+
+    static bool parse(const std::string &filename, Input &input);
+    static void parseXYZ(const std::string &filename, Input &input);
+    static void parseJSON(const std::string &filename, Input &input);
+
+    /// @return false if no keyframe could be dropped
+    bool decimate();
+    void evict();
+    void detachCache();
   };
 }
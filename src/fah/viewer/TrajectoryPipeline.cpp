@@ -0,0 +1,227 @@
+/******************************************************************************\
+
+                       This file is part of the FAHViewer.
+
+            The FAHViewer displays 3D views of Folding@home proteins.
+                    Copyright (c) 2016-2020, foldingathome.org
+                   Copyright (c) 2003-2016, Stanford University
+                               All rights reserved.
+
+       This program is free software; you can redistribute it and/or modify
+       it under the terms of the GNU General Public License as published by
+        the Free Software Foundation; either version 2 of the License, or
+                       (at your option) any later version.
+
+         This program is distributed in the hope that it will be useful,
+          but WITHOUT ANY WARRANTY; without even the implied warranty of
+          MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+                   GNU General Public License for more details.
+
+     You should have received a copy of the GNU General Public License along
+     with this program; if not, write to the Free Software Foundation, Inc.,
+           51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+                  For information regarding this software email:
+                                 Joseph Coffland
+                          joseph@cauldrondevelopment.com
+
+\******************************************************************************/
+
+
+#include "TrajectoryPipeline.h"
+
+#include <cbang/Catch.h>
+#include <cbang/log/Logger.h>
+#include <cbang/time/Timer.h>
+
+#include <algorithm>
+
+using namespace std;
+using namespace cb;
+using namespace FAH;
+
+
+TrajectoryPipeline::TrajectoryPipeline(Trajectory &trajectory,
+                                       unsigned depth) :
+  trajectory(trajectory), center(trajectory.getCenter()),
+  align(trajectory.getAlign()), massWeighted(trajectory.getMassWeighted()),
+  epoch(0), topology(trajectory.getTopology()), inFlight(0) {
+
+  for (unsigned i = 0; i <= STAGE_COUNT; i++)
+    queues.push_back(new queue_t(depth));
+
+  for (unsigned i = 0; i < STAGE_COUNT; i++)
+    threads.push_back(thread(&TrajectoryPipeline::run, this, i));
+}
+
+
+TrajectoryPipeline::~TrajectoryPipeline() {
+  for (unsigned i = 0; i < queues.size(); i++) queues[i]->close();
+  for (unsigned i = 0; i < threads.size(); i++) threads[i].join();
+}
+
+
+const char *TrajectoryPipeline::getStageName(unsigned stage) {
+  switch (stage) {
+  case STAGE_UNWRAP: return "unwrap";
+  case STAGE_CENTER: return "center";
+  case STAGE_ALIGN:  return "align";
+  case STAGE_BONDS:  return "bonds";
+  default:           return "invalid";
+  }
+}
+
+
+TrajectoryPipeline::Stats TrajectoryPipeline::getStats(unsigned stage) {
+  lock_guard<mutex> guard(statsLock);
+  return stats[stage];
+}
+
+
+TrajectoryPipeline::Stats TrajectoryPipeline::getLatency() {
+  lock_guard<mutex> guard(statsLock);
+  return latency;
+}
+
+
+void TrajectoryPipeline::reset(const SmartPointer<Topology> &topology) {
+  // Frames still in flight point to the old topology
+  if (!this->topology.isNull()) retired.push_back(this->topology);
+
+  this->topology = topology;
+  epoch++;
+}
+
+
+bool TrajectoryPipeline::push(SmartPointer<Positions> &positions) {
+  if (positions->empty()) THROW("Not adding empty positions");
+
+  // Take the only reference, adopt() throws if there is another
+  unique_ptr<Frame> frame(new Frame(epoch, positions.adopt(), topology.get(),
+                                    Timer::now()));
+  inFlight++;
+
+  if (queues[0]->tryPush(frame)) return true;
+
+  // Full, give the positions back
+  inFlight--;
+  positions = frame->positions.adopt();
+  return false;
+}
+
+
+bool TrajectoryPipeline::commit() {
+  queue_t &done = *queues[STAGE_COUNT];
+  unique_ptr<Frame> frame;
+  bool added = false;
+
+  while (done.tryPop(frame)) {
+    if (frame->epoch != epoch) {drop(frame); continue;} // Topology changed
+
+    try {
+      // The bonds stage found bonds, only this frame carries them
+      if (!frame->bonded.isNull()) trajectory.setTopology(frame->bonded);
+
+      trajectory.addProcessed(frame->positions, frame->rmsd);
+      added = true;
+    } CATCH_ERROR;
+
+    double now = Timer::now();
+    record(latency, now - frame->queued, now - frame->pushed);
+
+    LOG_DEBUG(4, "Keyframe added " << (now - frame->pushed) * 1000
+              << "ms after it arrived");
+
+    drop(frame);
+  }
+
+  // Nothing can point to an old topology once the pipeline is empty
+  if (!inFlight) retired.clear();
+
+  return added;
+}
+
+
+void TrajectoryPipeline::run(unsigned stage) {
+  queue_t &input = *queues[stage];
+  queue_t &output = *queues[stage + 1];
+  State state;
+  unique_ptr<Frame> frame;
+
+  while (input.pop(frame)) {
+    // Drop frames for an old topology without processing them
+    if (frame->epoch != epoch) {drop(frame); continue;}
+
+    if (frame->epoch != state.epoch) {
+      state = State();
+      state.epoch = frame->epoch;
+    }
+
+    double start = Timer::now();
+    bool processed = false;
+
+    try {
+      process(stage, *frame, state);
+      processed = true;
+    } CATCH_ERROR;
+
+    if (!processed) {drop(frame); continue;}
+
+    double now = Timer::now();
+    record(stats[stage], start - frame->queued, now - start);
+    frame->queued = now;
+
+    // Not touched again here once the next stage has it
+    if (!output.push(std::move(frame))) break; // Closed
+  }
+}
+
+
+void TrajectoryPipeline::process(unsigned stage, Frame &frame,
+                                 State &state) {
+  Positions &p = *frame.positions;
+
+  switch (stage) {
+  case STAGE_UNWRAP: Trajectory::shiftIntoBox(p, state.offsets); break;
+
+  case STAGE_CENTER: if (center) p.translateToCenterOfMass(); break;
+
+  case STAGE_ALIGN:
+    if (align && !state.last.empty())
+      frame.rmsd = Trajectory::alignTo(p, state.last,
+                                       frame.topology->getAtoms(),
+                                       massWeighted);
+    if (align) state.last = p; // A copy, the frame moves on to other threads
+    break;
+
+  case STAGE_BONDS:
+    if (!state.bonded && frame.topology->getBonds().empty()) {
+      // Work on a copy, the render thread may be drawing the original
+      SmartPointer<Topology> topology = new Topology(*frame.topology);
+      topology->findBonds(p);
+      topology->setTS();
+
+      // The Trajectory keeps it, so later frames need not carry it
+      if (!topology->getBonds().empty()) {
+        frame.bonded = topology;
+        state.bonded = true;
+      }
+    }
+    break;
+  }
+}
+
+
+void TrajectoryPipeline::record(Stats &stats, double waiting, double time) {
+  lock_guard<mutex> guard(statsLock);
+  stats.frames++;
+  stats.total += time;
+  stats.max = max(stats.max, time);
+  stats.waiting += waiting;
+}
+
+
+void TrajectoryPipeline::drop(unique_ptr<Frame> &frame) {
+  frame.reset();
+  inFlight--;
+}
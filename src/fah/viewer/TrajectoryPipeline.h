@@ -0,0 +1,147 @@
+/******************************************************************************\
+
+                       This file is part of the FAHViewer.
+
+            The FAHViewer displays 3D views of Folding@home proteins.
+                    Copyright (c) 2016-2020, foldingathome.org
+                   Copyright (c) 2003-2016, Stanford University
+                               All rights reserved.
+
+       This program is free software; you can redistribute it and/or modify
+       it under the terms of the GNU General Public License as published by
+        the Free Software Foundation; either version 2 of the License, or
+                       (at your option) any later version.
+
+         This program is distributed in the hope that it will be useful,
+          but WITHOUT ANY WARRANTY; without even the implied warranty of
+          MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+                   GNU General Public License for more details.
+
+     You should have received a copy of the GNU General Public License along
+     with this program; if not, write to the Free Software Foundation, Inc.,
+           51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+                  For information regarding this software email:
+                                 Joseph Coffland
+                          joseph@cauldrondevelopment.com
+
+\******************************************************************************/
+
+
+#pragma once
+
+#include "Trajectory.h"
+#include "BlockingQueue.h"
+
+#include <cbang/SmartPointer.h>
+
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <thread>
+
+
+namespace FAH {
+  /// Processes incoming keyframes off the render thread.  Each step of
+  /// Trajectory::add() runs as its own stage on its own thread, with
+  /// bounded queues in between.  Frames reach the Trajectory only through
+  /// commit(), on the render thread, once every stage is done with them.
+  class TrajectoryPipeline {
+  public:
+    enum {
+      STAGE_UNWRAP,
+      STAGE_CENTER,
+      STAGE_ALIGN,
+      STAGE_BONDS,
+      STAGE_COUNT,
+    };
+
+    struct Stats {
+      uint64_t frames = 0;
+      double total    = 0; ///< Seconds spent processing
+      double max      = 0; ///< Longest time spent on one frame
+      double waiting  = 0; ///< Seconds frames spent queued for the stage
+
+      double getAverage() const {return frames ? total / frames : 0;}
+    };
+
+  protected:
+    /// cb::SmartPointer reference counts are not atomic, so a Frame and
+    /// everything it owns belongs to exactly one thread at a time.  It is
+    /// handed from stage to stage and never shared.
+    struct Frame {
+      unsigned epoch;
+      cb::SmartPointer<Positions> positions;
+      /// Owned by the render thread, which keeps it alive until the
+      /// pipeline is empty.  Stages only read from it.
+      const Topology *topology;
+      /// Set by the bonds stage on the one frame which carries new bonds
+      cb::SmartPointer<Topology> bonded;
+      double rmsd = 0;
+      double pushed; ///< When the frame entered the pipeline
+      double queued; ///< When the frame entered its current queue
+
+      Frame(unsigned epoch, Positions *positions, const Topology *topology,
+            double now) :
+        epoch(epoch), positions(positions), topology(topology), pushed(now),
+        queued(now) {}
+    };
+
+    /// What a stage carries from one frame to the next
+    struct State {
+      unsigned epoch = 0;
+      std::vector<cb::Vector3D> offsets;
+      Positions last; ///< A private copy of the previous aligned frame
+      bool bonded = false;
+    };
+
+    typedef BlockingQueue<std::unique_ptr<Frame> > queue_t;
+
+    Trajectory &trajectory;
+    const bool center;
+    const bool align;
+    const bool massWeighted;
+
+    std::atomic<unsigned> epoch;
+    cb::SmartPointer<Topology> topology; ///< For new frames, render thread
+    /// Old topologies frames may still point to, render thread
+    std::vector<cb::SmartPointer<Topology> > retired;
+    std::atomic<unsigned> inFlight;
+
+    /// Queue i feeds stage i, the last one feeds commit()
+    std::vector<cb::SmartPointer<queue_t> > queues;
+    std::vector<std::thread> threads;
+
+    std::mutex statsLock;
+    Stats stats[STAGE_COUNT];
+    Stats latency; ///< From push() to commit()
+
+  public:
+    TrajectoryPipeline(Trajectory &trajectory, unsigned depth = 4);
+    ~TrajectoryPipeline();
+
+    static const char *getStageName(unsigned stage);
+    Stats getStats(unsigned stage);
+    Stats getLatency();
+
+    /// Frames still in flight are dropped.  Called from the render thread.
+    void reset(const cb::SmartPointer<Topology> &topology);
+
+    /// Never blocks.  Called from the render thread.
+    /// @param positions must not be referenced anywhere else.  The pipeline
+    /// takes it over unless the push fails.
+    /// @return false if the pipeline is full
+    bool push(cb::SmartPointer<Positions> &positions);
+
+    /// Add finished frames to the Trajectory.  Called from the render thread.
+    /// @return true if any frames were added
+    bool commit();
+
+  protected:
+    void run(unsigned stage);
+    void process(unsigned stage, Frame &frame, State &state);
+    void record(Stats &stats, double waiting, double time);
+    void drop(std::unique_ptr<Frame> &frame);
+  };
+}
@@ -29,7 +29,7 @@
 
 #include "View.h"
 
-#include "TestData.h"
+#include "GL.h"
 
 #ifdef _WIN32
 #include "wtypes.h"
@@ -37,13 +37,16 @@
 
 #include <fah/viewer/advanced/AdvancedViewer.h>
 #include <fah/viewer/basic/BasicViewer.h>
+#include <fah/viewer/impostor/ImpostorViewer.h>
 
 #include <cbang/Exception.h>
 #include <cbang/log/Logger.h>
 #include <cbang/time/Time.h>
-#include <cbang/os/SystemUtilities.h>
+#include <cbang/time/TimeInterval.h>
 #include <cbang/Catch.h>
 
+#include <cmath>
+
 using namespace std;
 using namespace cb;
 using namespace FAH;
@@ -67,6 +70,25 @@ View::View(cb::Options &options) : options(options) {
   options.addTarget("password", password, "A password for accessing the remote "
                     "client")->setObscured();
   options.addTarget("slot", slot, "Slot on the client to view");
+  options.addTarget("capture", capture, "Record the raw data received from "
+                    "the client, with timestamps, to this file");
+  options.addTarget("replay", replay, "Replay a session recorded with "
+                    "--capture from a local stand-in client instead of "
+                    "connecting to a real one");
+  options.addTarget("replay-speed", replaySpeed, "Replay pacing relative to "
+                    "the recording.  Zero replays as fast as possible");
+  options.addTarget("replay-port", replayPort, "Local port the stand-in "
+                    "client listens on during replay");
+  options.addTarget("load-threads", loadThreads, "Number of threads used to "
+                    "parse input files, zero for one per core");
+  options.addTarget("convert", convert, "Convert the input files to a binary "
+                    "trajectory cache with the given name and exit.  Inputs "
+                    "may be XYZ, JSON, captured sessions or other caches");
+  options.addTarget("export", exportFile, "File written when the current "
+                    "trajectory is exported with the 'x' key");
+  options.addTarget("dashboard", dashboard, "Show several slots at once, "
+                    "each in its own tile.  A space separated list of "
+                    "<host | IP>[:<port>][/<slot>[,<slot>...]] entries");
   options.add("test", "Load test data")->setDefault(true);
 
   options.add("recompute-bonds", "Recompute bonds from expected bond lengths"
@@ -74,6 +96,11 @@ View::View(cb::Options &options) : options(options) {
   options.addTarget("interpolation-steps", interpSteps, "The number of "
                     "interpolated protein views to calculate between "
                     "snapshots.");
+  options.addTarget("trajectory-max-mb", trajectoryMaxMB, "Maximum memory, "
+                    "in MiB, used to store snapshots.  Older snapshots are "
+                    "thinned out when it is exceeded.  Zero for no limit.");
+  options.addTarget("mass-weighted-alignment", massWeighted, "Weight atoms "
+                    "by mass when aligning consecutive snapshots");
   options.addTarget("wiggle", wiggle, "Enable atom wiggling which "
                     "approximates simulation activity");
   options.addTarget("x-rotation", degreesPerSec.x(), "Rotation about the "
@@ -85,6 +112,12 @@ View::View(cb::Options &options) : options(options) {
   options.addTarget("zoom", zoom, "Zoom level");
   options.addTarget("mode", modeNumber, "Render mode");
   options.addTarget("blur", blur, "Enable blur (advanced only)");
+  options.addTarget("instancing", instancing, "Draw atoms with a single "
+                    "instanced draw call when supported (basic only)");
+  options.addTarget("culling", culling, "Skip atoms and bonds outside the "
+                    "view (basic only)");
+  options.addTarget("occlusion-culling", occlusion, "Also skip atoms hidden "
+                    "behind nearer atoms in space filled mode (basic only)");
   options.addTarget("show-info", showInfo, "Display simulation info");
   options.addTarget("show-logos", showLogos, "Display logos");
   options.addTarget("show-buttons", showButtons, "Display buttons");
@@ -112,10 +145,6 @@ void View::initView(const vector<string> &inputs) {
   if (zoom < 0.2) zoom = 0.2;
   if (3 < zoom) zoom = 3;
 
-  // Mode
-  if (modeNumber) mode = (ViewMode::enum_t)(modeNumber - 1);
-  setMode(mode);
-
   // Background
   if (options["background"].hasValue()) {
     if (options["background"].toString() != "none")
@@ -143,40 +172,88 @@ void View::initView(const vector<string> &inputs) {
   } else if (profile != "default")
     LOG_WARNING("Unsupported profile='" << profile << "'");
 
-  trajectory = new Trajectory(true, true, interpSteps);
+  tile = new Tile(createTrajectory());
+  tiles.push_back(tile);
+  Trajectory &trajectory = tile->getTrajectory();
 
   // Load data
   if (!inputs.empty()) {
-    for (unsigned i = 0; i < inputs.size(); i++) {
-      string ext = SystemUtilities::extension(inputs[i]);
-
-      try {
-        if (ext == "xyz") trajectory->readXYZ(inputs[i]);
-        else if (ext == "json") trajectory->readJSON(inputs[i]);
-        else THROW("Input file with unknown extension '" << inputs[i] << "'");
-      } CATCH_ERROR;
-    }
+    loadInputs(trajectory, inputs);
 
     // Make fake topology if none was loaded
-    trajectory->ensureTopology();
+    trajectory.ensureTopology();
 
-    if (options["recompute-bonds"].toBoolean()) trajectory->recomputeBonds();
+    if (options["recompute-bonds"].toBoolean()) trajectory.recomputeBonds();
 
   } else if (options["test"].isSet() && options["test"].toBoolean())
     loadTestData();
 
-  else if (client.isNull() && options["connect"].hasValue() &&
-           String::toLower(options["connect"].toString()) != "false") {
+  else if (!dashboard.empty()) addDashboardTiles(dashboard);
+
+  else if (!replay.empty()) {
+    IPAddress addr("127.0.0.1");
+    addr.setPort(replayPort);
+
+    replayServer = new ReplayServer(replay, addr, replaySpeed);
+    replayServer->start();
+
+    tile->setClient(createClient(addr, slot, tile->getSimulationInfo(),
+                                 trajectory));
+
+  } else if (tile->getClient().isNull() && options["connect"].hasValue() &&
+             String::toLower(options["connect"].toString()) != "false") {
 
     IPAddress addr(options["connect"]);
     if (!addr.getPort()) addr.setPort(36330); // The default port
-    if (addr.getIP()) client = createClient(addr);
+    if (addr.getIP())
+      tile->setClient(createClient(addr, slot, tile->getSimulationInfo(),
+                                   trajectory));
+  }
+
+  // Session capture
+  if (!capture.empty()) {
+    if (isDashboard())
+      LOG_WARNING("Session capture is not supported in dashboard mode");
+    else if (!tile->getClient().isNull())
+      tile->getClient()->setCapture(new SessionWriter(capture));
   }
+
+  layoutTiles();
+
+  // Mode, after the tiles since the dashboard limits the available modes
+  if (modeNumber) mode = (ViewMode::enum_t)(modeNumber - 1);
+  setMode(mode);
+}
+
+
+void View::convertInputs(const vector<string> &inputs) {
+  if (inputs.empty()) THROW("No input files to convert");
+
+  // Keep every keyframe
+  SmartPointer<Trajectory> trajectory = createTrajectory();
+  trajectory->setMaxBytes(0);
+
+  loadInputs(*trajectory, inputs);
+  trajectory->ensureTopology();
+  if (options["recompute-bonds"].toBoolean()) trajectory->recomputeBonds();
+
+  TrajectoryCache::write(convert, *trajectory);
+}
+
+
+void View::exportTrajectory() {
+  try {
+    Trajectory &trajectory = getTrajectory();
+    if (trajectory.empty()) THROW("No trajectory to export");
+
+    trajectory.ensureTopology();
+    TrajectoryCache::write(exportFile, trajectory);
+  } CATCH_ERROR;
 }
 
 
 void View::loadTestData() {
-  TestData::load(*trajectory);
+  tile->loadTestData();
 }
 
 
@@ -201,24 +278,37 @@ void View::setHeight(unsigned height) {
 }
 
 
+static ViewerBase *createViewer(ViewMode mode) {
+  if (mode < ViewMode::MODE_ADV_SPACE_FILLED) return new BasicViewer;
+  if (mode < ViewMode::MODE_IMPOSTOR_SPACE_FILLED) return new AdvancedViewer;
+  return new ImpostorViewer;
+}
+
+
+static unsigned getViewerClass(ViewMode mode) {
+  if (mode < ViewMode::MODE_ADV_SPACE_FILLED) return 0;
+  if (mode < ViewMode::MODE_IMPOSTOR_SPACE_FILLED) return 1;
+  return 2;
+}
+
+
 void View::setMode(ViewMode mode) {
   if (!viewer.isNull() && this->mode == mode) return;
   if (ViewMode::getCount() <= (unsigned)mode)
     mode = (ViewMode::enum_t)((unsigned)mode % ViewMode::getCount());
-  if (MODE_ADV_SPACE_FILLED <= mode && basic)
+  if (MODE_IMPOSTOR_SPACE_FILLED <= mode && basic)
+    mode = (ViewMode::enum_t)
+      ((unsigned)mode - (unsigned)MODE_IMPOSTOR_SPACE_FILLED);
+  // Advanced modes post process the whole window so do not work in tiles
+  else if (MODE_ADV_SPACE_FILLED <= mode &&
+           mode < MODE_IMPOSTOR_SPACE_FILLED && (basic || isDashboard()))
     mode = (ViewMode::enum_t)((unsigned)mode % (unsigned)MODE_ADV_SPACE_FILLED);
 
   if (!viewer.isNull()) viewer->release();
 
   // Update viewer
-  if (this->mode < MODE_ADV_SPACE_FILLED && MODE_ADV_SPACE_FILLED <= mode)
-    viewer = new AdvancedViewer;
-
-  if (mode < MODE_ADV_SPACE_FILLED && MODE_ADV_SPACE_FILLED <= this->mode)
-    viewer = new BasicViewer;
-
-  if (viewer.isNull()) viewer = mode < MODE_ADV_SPACE_FILLED ?
-                         new BasicViewer : new AdvancedViewer;
+  if (viewer.isNull() || getViewerClass(this->mode) != getViewerClass(mode))
+    viewer = createViewer(mode);
 
   this->mode = mode;
 
@@ -235,14 +325,10 @@ void View::setPause(bool pause) {
 
 
 void View::setSlot(unsigned slot) {
-  if (slot == this->slot) return;
-
-  if (!client.isNull()) {
-    if (!client->setSlot(slot)) return;
-    connectTime = Time::now();
-    info = SimulationInfo();
-    trajectory->clear();
-    protein = 0;
+  if (slot == getSlot()) return;
+
+  if (!tile->getClient().isNull()) {
+    if (!tile->setSlot(slot)) return;
     redisplay();
   }
 
@@ -251,37 +337,11 @@ void View::setSlot(unsigned slot) {
 
 
 unsigned View::getSlot() {
-  if (!client.isNull()) slot = client->getSlot();
+  if (!tile->getClient().isNull()) slot = tile->getClient()->getSlot();
   return slot;
 }
 
 
-string View::getStatus() const {
-  if (trajectory->empty() && !client.isNull()) {
-    if (info.coreType == 0x22) return "Incompat";
-    else if (client->hasLoadableSlot()) return "Loading";
-    else if (client->isConnected()) return "Awaiting";
-    else return "";
-
-  } else return info.project ? "Live" : "Demo";
-}
-
-
-string View::getFrameDescription() const {
-  unsigned total = totalFrames;
-  unsigned current = total ? 1 + currentFrame : 0;
-
-  if (interpSteps && 1 < total) {
-    total = total / (interpSteps + 1) + 1;
-    unsigned iCurrent = (current - 1) % (interpSteps + 1);
-    current = (current - 1) / (interpSteps + 1) + 1;
-    return String::printf("%d.%d of %d", current, iCurrent, total);
-  }
-
-  return String::printf("%d of %d", current, total);
-}
-
-
 void View::showPopup(const string &name) {
   if (name == "about") {
     closePopup();
@@ -320,6 +380,15 @@ void View::zoomOut() {
 
 
 void View::click(const Vector2D &pos) {
+  // Focus the clicked tile, the y-axis is flipped relative to GL
+  if (isDashboard() && !popupVisible())
+    for (unsigned i = 0; i < tiles.size(); i++)
+      if (tiles[i]->contains(pos.x(), height - pos.y())) {
+        tile = tiles[i];
+        redisplay();
+        break;
+      }
+
   string pick = viewer->pick(pos);
 
   if (pick == "up") viewer->lineUp(5);
@@ -375,7 +444,13 @@ void View::spinLeft() {
 
 
 void View::draw() {
-  viewer->draw(info, protein.get(), *this);
+  if (isDashboard()) drawTiles();
+  else {
+    double start = Timer::now();
+    viewer->draw(tile->getSimulationInfo(), tile->getProtein().get(), *this);
+    tile->setDrawTime(Timer::now() - start);
+  }
+
   renderTimer.throttle(renderSpeed);
 }
 
@@ -386,19 +461,116 @@ void View::resize(unsigned width, unsigned height) {
   this->width = width;
   this->height = height;
 
+  layoutTiles();
   viewer->resize(*this);
 }
 
 
-static uint32_t xorshift_rand() {
-  static uint32_t rand_x = 123456789;
-  static uint32_t rand_y = 362436069;
-  static uint32_t rand_z = 521288629;
-  static uint32_t rand_w = 88675123;
+void View::loadInputs(Trajectory &trajectory, const vector<string> &inputs) {
+  double start = Timer::now();
+  trajectory.read(inputs, loadThreads);
+
+  LOG_INFO(1, "Loaded " << inputs.size() << " input files with "
+           << trajectory.getKeyframeCount() << " keyframes in "
+           << TimeInterval(Timer::now() - start));
+}
+
 
-  uint32_t t = rand_x ^ (rand_x << 11);
-  rand_x = rand_y; rand_y = rand_z; rand_z = rand_w;
-  return rand_w = rand_w ^ (rand_w >> 19) ^ (t ^ (t >> 8));
+SmartPointer<Trajectory> View::createTrajectory() const {
+  SmartPointer<Trajectory> trajectory =
+    new Trajectory(true, true, interpSteps);
+  trajectory->setMassWeighted(massWeighted);
+  trajectory->setMaxBytes((uint64_t)trajectoryMaxMB << 20);
+  return trajectory;
+}
+
+
+SmartPointer<Tile> View::createTile(const IPAddress &addr, unsigned slot) {
+  SmartPointer<Tile> tile = new Tile(createTrajectory());
+  tile->setClient(createClient(addr, slot, tile->getSimulationInfo(),
+                               tile->getTrajectory()));
+  return tile;
+}
+
+
+void View::addDashboardTiles(const string &spec) {
+  vector<SmartPointer<Tile> > tiles;
+  vector<string> entries;
+  String::tokenize(spec, entries);
+
+  for (unsigned i = 0; i < entries.size(); i++) {
+    size_t pos = entries[i].find('/');
+
+    IPAddress addr(entries[i].substr(0, pos));
+    if (!addr.getPort()) addr.setPort(36330); // The default port
+
+    vector<string> slots;
+    if (pos != string::npos)
+      String::tokenize(entries[i].substr(pos + 1), slots, ",");
+    if (slots.empty()) slots.push_back("0");
+
+    for (unsigned j = 0; j < slots.size(); j++)
+      tiles.push_back(createTile(addr, String::parseU32(slots[j])));
+  }
+
+  if (tiles.empty()) THROW("Invalid dashboard '" << spec << "'");
+
+  this->tiles = tiles;
+  tile = tiles[0];
+
+  LOG_INFO(1, "Dashboard with " << tiles.size() << " tiles");
+}
+
+
+void View::layoutTiles() {
+  unsigned count = tiles.size();
+  if (!count) return;
+
+  // As square a grid as possible, filled from the top left
+  unsigned cols = (unsigned)ceil(sqrt((double)count));
+  unsigned rows = (count + cols - 1) / cols;
+
+  for (unsigned i = 0; i < count; i++) {
+    unsigned col = i % cols;
+    unsigned row = i / cols;
+    unsigned left = col * width / cols;
+    unsigned right = (col + 1) * width / cols;
+    unsigned top = row * height / rows;
+    unsigned bottom = (row + 1) * height / rows;
+
+    tiles[i]->setViewport(left, height - bottom, right - left, bottom - top);
+  }
+}
+
+
+void View::drawTiles() {
+  SmartPointer<Tile> focus = tile;
+  drawingTile = true;
+
+  // The tiles share the viewer and its GPU resources, only the viewport,
+  // simulation info and protein change between them
+  for (unsigned i = 0; i < tiles.size(); i++) {
+    tile = tiles[i];
+
+    glViewport(tile->getX(), tile->getY(), tile->getWidth(),
+               tile->getHeight());
+    glScissor(tile->getX(), tile->getY(), tile->getWidth(),
+              tile->getHeight());
+    glEnable(GL_SCISSOR_TEST);
+
+    double start = Timer::now();
+    viewer->draw(tile->getSimulationInfo(), tile->getProtein().get(), *this);
+    tile->setDrawTime(Timer::now() - start);
+  }
+
+  glDisable(GL_SCISSOR_TEST);
+  glViewport(0, 0, width, height);
+
+  tile = focus;
+  drawingTile = false;
+
+  // Popups cover the whole window
+  viewer->drawPopups(*this);
 }
 
 
@@ -442,39 +614,20 @@ void View::decFPS() {
 
 void View::update(bool fast) {
   bool redisplay = false;
+  bool hasData = false;
+  bool cycling = false;
 
-  // Update client connection
-  if (!client.isNull()) {
-    if (client->update()) redisplay = true;
-
-    // Load "Demo" protein after timeout
-    if (!client->isConnected()) {
-      if (!connectTime) connectTime = Time::now();
-      else if (trajectory->empty() && connectTime + 5 <= Time::now()) {
-        loadTestData();
-        redisplay = true;
-      }
-    }
-
-    // Update status
-    string status;
-    switch (client->getState()) {
-    case Client::STATE_WAITING: status = "Trying"; break;
-    case Client::STATE_CONNECTING: status = "Connecting"; break;
-    default: status = "Connected"; break;
-    }
+  // Update client connections
+  for (unsigned i = 0; i < tiles.size(); i++) {
+    if (tiles[i]->update()) redisplay = true;
 
-    if (connectionStatus != status) {
-      connectTime = 0;
-      connectionStatus = status;
-      redisplay = true;
-    }
+    Trajectory &trajectory = tiles[i]->getTrajectory();
+    if (!trajectory.empty()) hasData = true;
+    if (1 < trajectory.size() && cycle) cycling = true;
   }
 
   // Animate
-  totalFrames = trajectory->size();
-  if (totalFrames <= currentFrame) currentFrame = 0;
-  if (!trajectory->empty() && !pause && lastFrame + 1.0 / fps < Timer::now()) {
+  if (hasData && !pause && lastFrame + 1.0 / fps < Timer::now()) {
     // Rotate X
     if (rotate) {
       if (degreesPerSec.x()) {
@@ -501,52 +654,18 @@ void View::update(bool fast) {
 
     lastFrame = Timer::now();
 
-    // Cycle frames
-    unsigned oldFrame = currentFrame;
-
-    if (1 < trajectory->size() && cycle) {
-      // Advance frame
-      if (forward) {
-        currentFrame += skipMultiplier;
-        if (trajectory->size() - 1 <= currentFrame) {
-          currentFrame = trajectory->size() - 1;
-          forward = false;
-        }
-
-      } else if (currentFrame <= skipMultiplier) {
-        currentFrame = 0;
-        forward = true;
-
-      } else currentFrame -= skipMultiplier;
-
-    } else if (!trajectory->empty()) currentFrame = trajectory->size() - 1;
+    // Cycle frames, each tile gets an equal share of the frame time
+    double budget = isDashboard() ? renderSpeed / tiles.size() : 0;
+    bool hasProtein = false;
 
-    if (oldFrame != currentFrame) {
-      if (currentFrame < trajectory->size())
-        protein = trajectory->getProtein(currentFrame);
-      else protein = 0;
-
-      redisplay = true;
+    for (unsigned i = 0; i < tiles.size(); i++) {
+      if (tiles[i]->animate(cycle, skipMultiplier, budget)) redisplay = true;
+      if (!tiles[i]->getProtein().isNull()) hasProtein = true;
     }
 
-    if (protein.isNull() && currentFrame < trajectory->size())
-      protein = trajectory->getProtein(currentFrame);
-
-    // Wiggle
-    if (!protein.isNull() && wiggle) {
-      double radius = protein->getRadius();
-      SmartPointer<Positions> positions =
-        new Positions(*trajectory->at(currentFrame));
-
-      for (unsigned i = 0; i < positions->size(); i++) {
-        uint32_t r = xorshift_rand();
-        positions->at(i) += Vector3D(0.1 - (r & 255) / (float)1280,
-                                     0.1 - ((r >> 8) & 255) / (float)1280,
-                                     0.1 - ((r >> 16) & 255) / (float)1280);
-      }
-
-      protein = new Protein(protein->getTopology(), positions);
-      protein->setRadius(radius);
+    // Wiggle, the displacement is applied by the viewer when drawing
+    if (hasProtein && wiggle) {
+      wiggleTick++;
       redisplay = true;
     }
   }
@@ -554,13 +673,14 @@ void View::update(bool fast) {
   if (redisplay) this->redisplay();
 
   // Throttle
-  if ((!pause && degreesPerSec != Vector2D()) ||
-      (1 < trajectory->size() && cycle) || fast)
+  if ((!pause && degreesPerSec != Vector2D()) || cycling || fast)
     idleTimer.throttle(renderSpeed);
   else idleTimer.throttle(idleSpeed);
 }
 
 
-SmartPointer<Client> View::createClient(const cb::IPAddress &addr) {
-  return new Client(addr, slot, info, *trajectory, password);
+SmartPointer<Client> View::createClient(const IPAddress &addr, unsigned slot,
+                                        SimulationInfo &info,
+                                        Trajectory &trajectory) {
+  return new Client(addr, slot, info, trajectory, password);
 }
@@ -29,9 +29,9 @@
 
 #pragma once
 
-#include "Client.h"
-#include "Trajectory.h"
+#include "Tile.h"
 #include "Viewer.h"
+#include "ReplayServer.h"
 
 #include <fah/viewer/basic/Texture.h>
 
@@ -51,11 +51,12 @@ namespace FAH {
   protected:
     cb::Options &options;
 
-    cb::SmartPointer<Client> client;
     cb::SmartPointer<ViewerBase> viewer;
-    cb::SmartPointer<Trajectory> trajectory;
-    SimulationInfo info;
-    cb::SmartPointer<Protein> protein;
+
+    std::vector<cb::SmartPointer<Tile> > tiles;
+    cb::SmartPointer<Tile> tile; ///< The focused tile or the one being drawn
+    bool drawingTile = false;
+    std::string dashboard;
 
     unsigned width  = 1024;
     unsigned height = 768;
@@ -65,9 +66,18 @@ namespace FAH {
     bool rotate     = true;
     bool cycle      = true;
     bool blur       = true;
+    bool instancing = true;
+    bool culling    = true;
+    bool occlusion  = true;
 
     std::string password;
 
+    std::string capture;
+    std::string replay;
+    double replaySpeed  = 1;
+    unsigned replayPort = 36331;
+    cb::SmartPointer<ReplayServer> replayServer;
+
     unsigned modeNumber = 4;
     ViewMode mode;
 
@@ -78,20 +88,22 @@ namespace FAH {
     cb::Vector2D degreesPerSec = cb::Vector2D(0, 5);
 
     double lastFrame        = 0;
-    unsigned currentFrame   = 0;
-    unsigned totalFrames    = 0;
     unsigned interpSteps    = 54;
+    bool massWeighted       = false;
     double fps              = 16;
     double oldFps           = 0;
-    bool forward            = true;
     bool turbo              = 0;
     unsigned skipMultiplier = 2;
     bool comingFromLowSpeed = false;
+    uint32_t wiggleTick     = 0;
 
     std::string profile = "default";
 
-    cb::Timer clientUpdate;
-    uint64_t connectTime = 0;
+    unsigned trajectoryMaxMB = 512;
+
+    unsigned loadThreads = 0;
+    std::string convert;
+    std::string exportFile = "trajectory.fvt";
 
     double renderSpeed = 1.0 / 32.0;
     cb::Timer renderTimer;
@@ -110,8 +122,6 @@ namespace FAH {
 
     cb::SmartPointer<Texture> bgTexture;
 
-    std::string connectionStatus = "None";
-
   public:
     View(cb::Options &options);
     virtual ~View() {}
@@ -119,21 +129,33 @@ namespace FAH {
     void initView(const std::vector<std::string> &inputs =
                   std::vector<std::string>());
 
+    /// Convert the inputs to a trajectory cache if requested
+    bool getConvert() const {return !convert.empty();}
+    void convertInputs(const std::vector<std::string> &inputs);
+    void exportTrajectory();
+
     void loadTestData();
 
-    Client &getClient() {return *client;}
+    bool isDashboard() const {return 1 < tiles.size();}
+    const std::vector<cb::SmartPointer<Tile> > &getTiles() const
+    {return tiles;}
+    Tile &getTile() {return *tile;}
+    const Tile &getTile() const {return *tile;}
+
+    Client &getClient() {return *tile->getClient();}
     void setClient(const cb::SmartPointer<Client> &client)
-    {this->client = client;}
+    {tile->setClient(client);}
 
     ViewerBase &getViewer() {return *viewer;}
     void setViewer(const cb::SmartPointer<ViewerBase> &viewer);
 
     void setTrajectory(const cb::SmartPointer<Trajectory> &trajectory)
-    {this->trajectory = trajectory;}
-    Trajectory &getTrajectory() {return *trajectory;}
+    {tile->setTrajectory(trajectory);}
+    Trajectory &getTrajectory() {return tile->getTrajectory();}
 
-    SimulationInfo &getSimulationInfo() {return info;}
-    const SimulationInfo &getSimulationInfo() const {return info;}
+    SimulationInfo &getSimulationInfo() {return tile->getSimulationInfo();}
+    const SimulationInfo &getSimulationInfo() const
+    {return tile->getSimulationInfo();}
 
     void setWidth(unsigned width);
     unsigned getWidth() const {return width;}
@@ -141,13 +163,24 @@ namespace FAH {
     void setHeight(unsigned height);
     unsigned getHeight() const {return height;}
 
+    /// The size of the area being drawn, a single tile in dashboard mode
+    unsigned getViewportWidth() const
+    {return drawingTile ? tile->getWidth() : width;}
+    unsigned getViewportHeight() const
+    {return drawingTile ? tile->getHeight() : height;}
+
     double getZoom() const {return zoom;}
 
+    /// The time available to draw one frame, shared by all dashboard tiles
+    double getFrameBudget() const {return renderSpeed / tiles.size();}
+
     void setBasic(bool basic) {this->basic = basic;}
     bool getBasic() const {return basic;}
 
     void setWiggle(bool wiggle) {this->wiggle = wiggle;}
     bool getWiggle() const {return wiggle;}
+    /// Advances on every wiggle update and seeds the per atom displacement
+    uint32_t getWiggleTick() const {return wiggleTick;}
 
     void setRotate(bool rotate) {this->rotate = rotate;}
     bool getRotate() const {return rotate;}
@@ -158,6 +191,15 @@ namespace FAH {
     void setBlur(bool blur) {this->blur = blur;}
     bool getBlur() const {return blur;}
 
+    void setInstancing(bool instancing) {this->instancing = instancing;}
+    bool getInstancing() const {return instancing;}
+
+    void setCulling(bool culling) {this->culling = culling;}
+    bool getCulling() const {return culling;}
+
+    void setOcclusion(bool occlusion) {this->occlusion = occlusion;}
+    bool getOcclusion() const {return occlusion;}
+
     void setMode(ViewMode mode);
     ViewMode getMode() const {return mode;}
 
@@ -174,8 +216,8 @@ namespace FAH {
     void setDegreesPerSec(const cb::Vector2D &dps) {degreesPerSec = dps;}
     const cb::Vector2D &getDegreesPerSec() const {return degreesPerSec;}
 
-    unsigned getCurrentFrame() const {return currentFrame;}
-    unsigned getTotalFrames() const {return totalFrames;}
+    unsigned getCurrentFrame() const {return tile->getCurrentFrame();}
+    unsigned getTotalFrames() const {return tile->getTotalFrames();}
     unsigned getInterpSteps() const {return interpSteps;}
 
     void incFPS();
@@ -193,20 +235,22 @@ namespace FAH {
     bool getShowLogos() const {return showLogos;}
 
     void setShowHelp(bool showHelp) {this->showHelp = showHelp;}
-    bool getShowHelp() const {return showHelp;}
+    bool getShowHelp() const {return showHelp && !drawingTile;}
 
     void setShowAbout(bool showAbout) {this->showAbout = showAbout;}
-    bool getShowAbout() const {return showAbout;}
+    bool getShowAbout() const {return showAbout && !drawingTile;}
 
     void setShowButtons(bool showButtons) {this->showButtons = showButtons;}
-    bool getShowButtons() const {return showButtons;}
+    bool getShowButtons() const {return showButtons && !drawingTile;}
 
     const cb::SmartPointer<Texture> &getBGTexture() const {return bgTexture;}
 
-    const std::string &getConnectionStatus() const {return connectionStatus;}
+    const std::string &getConnectionStatus() const
+    {return tile->getConnectionStatus();}
 
-    std::string getStatus() const;
-    std::string getFrameDescription() const;
+    std::string getStatus() const {return tile->getStatus();}
+    std::string getFrameDescription() const
+    {return tile->getFrameDescription(interpSteps);}
 
     void showPopup(const std::string &name);
     void closePopup();
@@ -233,7 +277,20 @@ namespace FAH {
     void resize(unsigned w, unsigned h);
     void update(bool fast);
 
-    virtual cb::SmartPointer<Client> createClient(const cb::IPAddress &addr);
+  protected:
+    void loadInputs(Trajectory &trajectory,
+                    const std::vector<std::string> &inputs);
+    cb::SmartPointer<Trajectory> createTrajectory() const;
+    cb::SmartPointer<Tile> createTile(const cb::IPAddress &addr,
+                                      unsigned slot);
+    void addDashboardTiles(const std::string &spec);
+    void layoutTiles();
+    void drawTiles();
+
+  public:
+    virtual cb::SmartPointer<Client>
+    createClient(const cb::IPAddress &addr, unsigned slot,
+                 SimulationInfo &info, Trajectory &trajectory);
     virtual void redisplay() {}
     virtual void reshape(unsigned width, unsigned height) {}
   };
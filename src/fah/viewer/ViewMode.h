@@ -48,5 +48,8 @@ CBANG_ENUM_EXPAND(MODE_ADV_BALL_AND_STICK,   4)
 CBANG_ENUM_EXPAND(MODE_ADV_STICK,            5)
 CBANG_ENUM_EXPAND(MODE_TOON_SPACE_FILLED,    6)
 CBANG_ENUM_EXPAND(MODE_TOON_BALL_AND_STICK,  7)
+CBANG_ENUM_EXPAND(MODE_IMPOSTOR_SPACE_FILLED, 8)
+CBANG_ENUM_EXPAND(MODE_IMPOSTOR_BALL_AND_STICK, 9)
+CBANG_ENUM_EXPAND(MODE_IMPOSTOR_STICK,       10)
 
 #endif // CBANG_ENUM_EXPAND
@@ -54,6 +54,8 @@ namespace FAH {
     virtual void draw(const SimulationInfo &info, const Protein *protein,
                       const View &view) = 0;
     virtual void resize(const View &view) = 0;
+    /// Draw popups over the whole window, used after drawing dashboard tiles
+    virtual void drawPopups(const View &view) {}
     virtual std::string pick(const cb::Vector2D &p) {return "";}
   };
 }
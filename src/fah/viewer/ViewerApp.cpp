@@ -132,6 +132,12 @@ int ViewerApp::init(int argc, char *argv[]) {
   // Parse command line, etc.
   Application::init(argc, argv);
 
+  // Offline conversion
+  if (getConvert()) {
+    convertInputs(cmdLine.getPositionalArgs());
+    return -1;
+  }
+
   // Blacklist certain GPUs which are known to BSOD on Windows.
   string render = Info::instance().get("System", "OpenGL Render");
   if (!force) {
@@ -340,6 +346,7 @@ void ViewerApp::keys(unsigned char key, int x, int y) {
     case 'b': setBlur(!getBlur()); break;
     case 'i': setShowInfo(!getShowInfo()); break;
     case 'l': setShowLogos(!getShowLogos()); break;
+    case 'x': exportTrajectory(); break;
     case 'q': case 'Q': quit(); break;
     case '\033': if (fullscreen) setFullscreen(false); break;
     }
@@ -220,8 +220,8 @@ void AdvancedViewer::drawBackground(const View &view) {
 
 
 void AdvancedViewer::applyBlur(const View &view) {
-  unsigned width = view.getWidth();
-  unsigned height = view.getHeight();
+  unsigned width = view.getViewportWidth();
+  unsigned height = view.getViewportHeight();
 
   // Copy the scene into a texture
   // Don't render directly to a texture because that skips zmask / hiz
@@ -327,6 +327,7 @@ void AdvancedViewer::drawScene(const Protein *protein, const View &view) {
 
   if (protein) {
     updatePerspective(protein->getRadius(), view);
+    selectDetail(*protein, view);
     drawShadows(*protein);
   }
 
@@ -394,9 +395,19 @@ void AdvancedViewer::release() {
 
 void AdvancedViewer::draw(const SimulationInfo &info, const Protein *protein,
                      const View &view) {
+  wiggle = view.getWiggle();
+  wiggleTick = view.getWiggleTick();
+  instancing = false; // Shadows need a texture matrix per atom
+  batching = false; // drawAtom() consumes random rotations in atom order
+  culler.disable(); // Atoms outside the view still cast shadows
+
+  beginTiming(view);
+
   // Draw main scene
   drawScene(protein, view);
 
   // Draw the rest
   BasicViewer::drawRest(info, view);
+
+  endTiming(view);
 }
@@ -45,6 +45,7 @@
 
 #include <fah/viewer/GL.h>
 #include <fah/viewer/View.h>
+#include <fah/viewer/Tile.h>
 
 #include <cctype>
 
@@ -67,10 +68,24 @@ namespace FAH {
 }
 
 
+namespace {
+  // Tessellation levels, coarsest first.  Bonds use the level of the atoms.
+  const unsigned sphereSlices[] = {8, 12, 16, 24, SUBDIVISIONS};
+  const unsigned cylinderSlices[] = {4, 5, 6, 8, 10};
+  const unsigned detailLevels = sizeof(sphereSlices) / sizeof(unsigned);
+
+  // Upper bound on the sphere vertices sent per frame
+  const double maxSphereVertices = 16e6;
+}
+
+
 BasicViewer::BasicViewer() :
-  mode(MODE_SPACE_FILLED), fontsLoaded(false), font(0), fontBold(0), box(0.6),
-  darkBox(0.8), cdLogo("cauldron_logo", 128, 48, 1),
-  fahLogo("FAH_logo2", 96, 96, 1), popupYOffset(0), popupPageHeight(0),
+  mode(MODE_SPACE_FILLED), fontsLoaded(false), font(0), fontBold(0),
+  timerSupported(false), box(0.6), darkBox(0.8),
+  cdLogo("cauldron_logo", 128, 48, 1), fahLogo("FAH_logo2", 96, 96, 1),
+  overlaySupported(false), batchTopology(0), batchTS(0),
+  wiggle(false), wiggleTick(0), instancing(false), batching(true),
+  culling(false), occlusion(false), popupYOffset(0), popupPageHeight(0),
   popupLineHeight(21), initialized(false) {
 
   const unsigned bSize = 48;
@@ -109,7 +124,7 @@ void BasicViewer::print(unsigned x, unsigned y, const string &s, bool bold) {
 void BasicViewer::resetDraw(const View &view) {
   glMatrixMode(GL_PROJECTION);
   glLoadIdentity();
-  gluOrtho2D(0, view.getWidth(), 0, view.getHeight());
+  gluOrtho2D(0, view.getViewportWidth(), 0, view.getViewportHeight());
   glMatrixMode(GL_MODELVIEW);
   glLoadIdentity();
 
@@ -118,12 +133,14 @@ void BasicViewer::resetDraw(const View &view) {
 }
 
 
-void BasicViewer::setMaterial(const Atom &atom) {
-  static const float shine[] = {
+namespace {
+  const float materialShine[] = {
     60, 20, 25, 30, 30, 100,
   };
 
-  static const float specular[][4] = {
+  const unsigned materialCount = sizeof(materialShine) / sizeof(float);
+
+  const float materialSpecular[][4] = {
     {0.45, 0.45, 0.50, 1.00}, // Carbon
     {0.20, 0.20, 0.20, 1.00}, // Hydrogen
     {0.20, 0.20, 0.20, 1.00}, // Nitrogen
@@ -132,7 +149,7 @@ void BasicViewer::setMaterial(const Atom &atom) {
     {0.25, 0.50, 0.25, 1.00}, // Heavy atoms
   };
 
-  static const float material[][4] = {
+  const float materialDiffuse[][4] = {
     {0.20, 0.20, 0.20, 1.00}, // dark grey
     {0.60, 0.60, 0.60, 1.00}, // grey
     {0.10, 0.10, 0.80, 1.00}, // blue
@@ -141,33 +158,85 @@ void BasicViewer::setMaterial(const Atom &atom) {
     {0.50, 0.00, 0.60, 1.00}, // purple
   };
 
-  int i;
-  switch (atom.getNumber()) {
-  case Atom::CARBON:   i = 0; break;
-  case Atom::HYDROGEN: i = 1; break;
-  case Atom::NITROGEN: i = 2; break;
-  case Atom::OXYGEN:   i = 3; break;
-  case Atom::SULFUR:   i = 4; break;
-  default:             i = 5; break;
+
+  unsigned getMaterialIndex(const Atom &atom) {
+    switch (atom.getNumber()) {
+    case Atom::CARBON:   return 0;
+    case Atom::HYDROGEN: return 1;
+    case Atom::NITROGEN: return 2;
+    case Atom::OXYGEN:   return 3;
+    case Atom::SULFUR:   return 4;
+    default:             return 5;
+    }
+  }
+}
+
+
+void BasicViewer::setMaterial(const Atom &atom) {
+  unsigned i = getMaterialIndex(atom);
+
+  glMaterialfv(GL_FRONT_AND_BACK, GL_DIFFUSE, materialDiffuse[i]);
+  glMaterialfv(GL_FRONT, GL_SHININESS, &materialShine[i]);
+  glMaterialfv(GL_FRONT, GL_SPECULAR, materialSpecular[i]);
+}
+
+
+void BasicViewer::getMaterial(const Atom &atom, float diffuse[4],
+                              float specular[4]) {
+  unsigned i = getMaterialIndex(atom);
+
+  for (unsigned j = 0; j < 4; j++) {
+    diffuse[j] = materialDiffuse[i][j];
+    specular[j] = materialSpecular[i][j];
+  }
+  specular[3] = materialShine[i];
+}
+
+
+bool BasicViewer::isSpaceFilledMode() const {
+  switch (mode) {
+  case MODE_SPACE_FILLED: case MODE_ADV_SPACE_FILLED:
+  case MODE_TOON_SPACE_FILLED: case MODE_IMPOSTOR_SPACE_FILLED: return true;
+  default: return false;
+  }
+}
+
+
+bool BasicViewer::isStickMode() const {
+  switch (mode) {
+  case MODE_STICK: case MODE_ADV_STICK: case MODE_IMPOSTOR_STICK: return true;
+  default: return false;
   }
+}
 
-  glMaterialfv(GL_FRONT_AND_BACK, GL_DIFFUSE, material[i]);
-  glMaterialfv(GL_FRONT, GL_SHININESS, &shine[i]);
-  glMaterialfv(GL_FRONT, GL_SPECULAR, specular[i]);
+
+double BasicViewer::getSphereSize() const {
+  if (isSpaceFilledMode()) return SPHERE_SIZE;
+  if (isStickMode()) return SPHERE_SIZE_TINY;
+  return SPHERE_SIZE_SMALL;
+}
+
+
+float BasicViewer::getAtomScale(const Atom &atom) const {
+  // Scale based on atom type
+  if (isStickMode()) return 1;
+  float scale = atom.getRadius() / 1.7;
+  return 0 < scale ? scale : 1;
 }
 
 
 void BasicViewer::drawAtom(const Atom &atom, const Vector3D &position) {
+  setMaterial(atom);
+  drawSphere(atom, position);
+}
+
+
+void BasicViewer::drawSphere(const Atom &atom, const Vector3D &position) {
   glPushMatrix();
   glTranslatef(position.x(), position.y(), position.z());
 
-  setMaterial(atom);
-
-  // Scale based on atom type
-  if (mode != MODE_STICK && mode != MODE_ADV_STICK) {
-    float scale = atom.getRadius() / 1.7;
-    if (0 < scale) glScalef(scale, scale, scale);
-  }
+  float scale = getAtomScale(atom);
+  if (scale != 1) glScalef(scale, scale, scale);
 
   sphere->draw();
 
@@ -178,10 +247,10 @@ void BasicViewer::drawAtom(const Atom &atom, const Vector3D &position) {
 void BasicViewer::drawBond(const Protein &protein, const Bond &bond) {
   const Positions &positions = *protein.getPositions();
   const Topology::atoms_t &atoms = protein.getTopology()->getAtoms();
-  const Atom leftAtom = atoms[bond.left];
-  const Atom rightAtom = atoms[bond.right];
-  const Vector3D &left = positions[bond.left];
-  const Vector3D &right = positions[bond.right];
+  const Atom &leftAtom = atoms[bond.left];
+  const Atom &rightAtom = atoms[bond.right];
+  const Vector3D left = getPosition(positions, bond.left);
+  const Vector3D right = getPosition(positions, bond.right);
   Vector3D diff = right - left;
   double length = left.distance(right);
   double avgLength = leftAtom.averageBondLength(rightAtom);
@@ -193,6 +262,8 @@ void BasicViewer::drawBond(const Protein &protein, const Bond &bond) {
     return;
   }
 
+  if (!culler.isVisible(left, right, BOND_RADIUS)) return;
+
   AxisAngleD angle(acos(diff.z() / length) * 57.2957, -diff.y(), diff.x(), 0);
 
   glPushMatrix();
@@ -205,7 +276,7 @@ void BasicViewer::drawBond(const Protein &protein, const Bond &bond) {
 
   setupShadow(left, angle); // Used by AdvancedViewer
 
-  if (mode == MODE_STICK || mode == MODE_ADV_STICK) {
+  if (isStickMode()) {
     setMaterial(leftAtom);
 
     glScalef(1, 1, 0.5 * length);
@@ -237,6 +308,30 @@ void BasicViewer::drawBond(const Protein &protein, const Bond &bond) {
 }
 
 
+static uint32_t wiggleHash(uint32_t x) {
+  x ^= x >> 16;
+  x *= 0x7feb352d;
+  x ^= x >> 15;
+  x *= 0x846ca68b;
+  x ^= x >> 16;
+  return x;
+}
+
+
+Vector3D BasicViewer::getPosition(const Positions &positions,
+                                  unsigned i) const {
+  if (!wiggle) return positions[i];
+
+  // Deterministic in the atom index and tick so the stored frame is never
+  // modified and every pass over the same frame sees the same displacement
+  uint32_t r = wiggleHash(i ^ wiggleHash(wiggleTick));
+
+  return positions[i] + Vector3D(0.1 - (r & 255) / (float)1280,
+                                 0.1 - ((r >> 8) & 255) / (float)1280,
+                                 0.1 - ((r >> 16) & 255) / (float)1280);
+}
+
+
 void BasicViewer::drawCuboid(const cb::Rectangle3D &r) {
   glPushAttrib(GL_ENABLE_BIT | GL_LINE_BIT | GL_CURRENT_BIT);
   glDisable(GL_LIGHTING);
@@ -269,22 +364,113 @@ void BasicViewer::drawBox(const Positions &positions) {
 
 
 void BasicViewer::drawAtoms(const Protein &protein) {
-  Positions &positions = *protein.getPositions();
+  const Positions &positions = *protein.getPositions();
   const Topology::atoms_t &atoms = protein.getTopology()->getAtoms();
 
   //drawBox(positions);
 
+  if (instancing && !instancer.isNull()) {
+    drawAtomsInstanced(protein);
+    return;
+  }
+
+  if (batching) {
+    drawAtomsBatched(protein);
+    return;
+  }
+
   sphere->bind();
   for (unsigned i = 0; i < atoms.size(); i++)
-    drawAtom(atoms[i], positions[i]);
+    if (culler.isVisible(i)) drawAtom(atoms[i], getPosition(positions, i));
   sphere->unbind();
 }
 
 
+void BasicViewer::updateBatches(const Topology &topology) {
+  const Topology::atoms_t &atoms = topology.getAtoms();
+
+  if (batchTopology == &topology && batchTS == topology.getTS() &&
+      batchOrder.size() == atoms.size()) return;
+
+  batchTopology = &topology;
+  batchTS = topology.getTS();
+
+  // Counting sort, atoms keep their topology order within a material
+  batchStart.assign(materialCount + 1, 0);
+  for (unsigned i = 0; i < atoms.size(); i++)
+    batchStart[getMaterialIndex(atoms[i]) + 1]++;
+
+  for (unsigned i = 0; i < materialCount; i++)
+    batchStart[i + 1] += batchStart[i];
+
+  vector<unsigned> next(batchStart.begin(), batchStart.end() - 1);
+  batchOrder.resize(atoms.size());
+  for (unsigned i = 0; i < atoms.size(); i++)
+    batchOrder[next[getMaterialIndex(atoms[i])]++] = i;
+}
+
+
+void BasicViewer::drawAtomsBatched(const Protein &protein) {
+  const Positions &positions = *protein.getPositions();
+  const Topology::atoms_t &atoms = protein.getTopology()->getAtoms();
+
+  updateBatches(*protein.getTopology());
+
+  // Opaque spheres with depth testing, so the order does not change the image
+  sphere->bind();
+
+  for (unsigned m = 0; m < materialCount; m++) {
+    unsigned start = batchStart[m];
+    unsigned end = batchStart[m + 1];
+    if (start == end) continue;
+
+    setMaterial(atoms[batchOrder[start]]);
+
+    for (unsigned j = start; j < end; j++) {
+      unsigned i = batchOrder[j];
+      if (culler.isVisible(i)) drawSphere(atoms[i], getPosition(positions, i));
+    }
+  }
+
+  sphere->unbind();
+}
+
+
+void BasicViewer::drawAtomsInstanced(const Protein &protein) {
+  const Positions &positions = *protein.getPositions();
+  const Topology::atoms_t &atoms = protein.getTopology()->getAtoms();
+
+  instances.resize(atoms.size());
+  unsigned count = 0;
+
+  for (unsigned i = 0; i < atoms.size(); i++) {
+    if (!culler.isVisible(i)) continue;
+
+    SphereInstancer::Instance &instance = instances[count++];
+    const Vector3D p = getPosition(positions, i);
+
+    instance.position[0] = p.x();
+    instance.position[1] = p.y();
+    instance.position[2] = p.z();
+    instance.position[3] = getAtomScale(atoms[i]);
+
+    getMaterial(atoms[i], instance.diffuse, instance.specular);
+  }
+
+  instances.resize(count);
+  instancer->draw(*sphere, instances);
+}
+
+
 void BasicViewer::drawBonds(const Protein &protein) {
   const Topology::bonds_t &bonds = protein.getTopology()->getBonds();
 
   if (mode != MODE_SPACE_FILLED && mode != MODE_ADV_SPACE_FILLED) {
+    if (instancing && !bondInstancer.isNull()) {
+      drawBondsInstanced(protein);
+      return;
+    }
+
     cylinder->bind();
     for (unsigned i = 0; i < bonds.size(); i++)
       drawBond(protein, bonds[i]);
@@ -293,6 +479,81 @@ void BasicViewer::drawBonds(const Protein &protein) {
 }
 
 
+static void setBondTransform(CylinderInstancer::Instance &instance,
+                             const Vector3D &origin, const Vector3D &axis,
+                             const Vector3D &side) {
+  for (unsigned i = 0; i < 3; i++) {
+    instance.origin[i] = origin[i];
+    instance.axis[i] = axis[i];
+    instance.side[i] = side[i];
+  }
+
+  instance.origin[3] = instance.axis[3] = instance.side[3] = 0;
+}
+
+
+void BasicViewer::drawBondsInstanced(const Protein &protein) {
+  const Positions &positions = *protein.getPositions();
+  const Topology::atoms_t &atoms = protein.getTopology()->getAtoms();
+  const Topology::bonds_t &bonds = protein.getTopology()->getBonds();
+  bool stick = isStickMode();
+
+  // The ball and stick bond material, see drawBond()
+  const float bondDiffuse[] = {0.4, 0.4, 0.0, 1.0};
+  const float bondSpecular[] = {0.25, 0.25, 0.25, 20};
+
+  // In stick mode each half of the bond takes the color of its atom
+  bondInstances.resize(bonds.size() * (stick ? 2 : 1));
+  unsigned count = 0;
+
+  for (unsigned i = 0; i < bonds.size(); i++) {
+    const Bond &bond = bonds[i];
+    const Atom &leftAtom = atoms[bond.left];
+    const Atom &rightAtom = atoms[bond.right];
+    const Vector3D left = getPosition(positions, bond.left);
+    const Vector3D right = getPosition(positions, bond.right);
+    const Vector3D diff = right - left;
+    double length = left.distance(right);
+
+    // Don't draw bonds which are too long
+    if (!length || leftAtom.averageBondLength(rightAtom) * 2 < length)
+      continue;
+
+    if (!culler.isVisible(left, right, BOND_RADIUS)) continue;
+
+    // Any unit vector perpendicular to the bond completes the transform
+    const Vector3D dir = diff / length;
+    const Vector3D side = dir.crossProduct(fabs(dir.x()) < 0.9 ?
+                                           Vector3D(1, 0, 0) :
+                                           Vector3D(0, 1, 0)).normalize();
+
+    if (stick) {
+      const Vector3D half = diff / 2.0;
+
+      CylinderInstancer::Instance &l = bondInstances[count++];
+      setBondTransform(l, left, half, side);
+      getMaterial(leftAtom, l.diffuse, l.specular);
+
+      CylinderInstancer::Instance &r = bondInstances[count++];
+      setBondTransform(r, left + half, half, side);
+      getMaterial(rightAtom, r.diffuse, r.specular);
+
+    } else {
+      CylinderInstancer::Instance &b = bondInstances[count++];
+      setBondTransform(b, left, diff, side);
+
+      for (unsigned j = 0; j < 4; j++) {
+        b.diffuse[j] = bondDiffuse[j];
+        b.specular[j] = bondSpecular[j];
+      }
+    }
+  }
+
+  bondInstances.resize(count);
+  bondInstancer->draw(*cylinder, bondInstances);
+}
+
+
 void BasicViewer::setupPerspective(const View &view, double radius) {
   radius *= view.getZoom();
   double zNear = 1;
@@ -302,7 +563,7 @@ void BasicViewer::setupPerspective(const View &view, double radius) {
   double bottom = -radius;
   double top = radius;
 
-  double aspect = (double)view.getWidth() / view.getHeight();
+  double aspect = (double)view.getViewportWidth() / view.getViewportHeight();
   if (aspect < 1) { // window taller than wide
     bottom /= aspect;
     top /= aspect;
@@ -326,6 +587,82 @@ void BasicViewer::setupPerspective(const View &view, double radius) {
 }
 
 
+void BasicViewer::beginTiming(const View &view) {
+  if (timerSupported) timers[&view.getTile()].begin();
+}
+
+
+void BasicViewer::endTiming(const View &view) {
+  if (timerSupported) timers[&view.getTile()].end();
+}
+
+
+double BasicViewer::getDrawTime(const View &view) const {
+  auto it = timers.find(&view.getTile());
+  if (it != timers.end() && it->second.hasResult())
+    return it->second.getElapsed();
+
+  // Without timer queries fall back to the time spent issuing commands
+  return view.getTile().getDrawTime();
+}
+
+
+void BasicViewer::selectDetail(const Protein &protein, const View &view) {
+  if (spheres.empty()) return;
+
+  // Screen pixels per unit, matches the orthographic projection set up by
+  // setupPerspective()
+  unsigned height = view.getViewportHeight();
+  double aspect = (double)view.getViewportWidth() / height;
+  double radius = protein.getRadius() * view.getZoom();
+  double pixelsPerUnit = radius ? height / (2 * radius) : 0;
+  if (aspect < 1) pixelsPerUnit *= aspect;
+
+  // About one slice per pixel of atom radius, bounded by the vertex budget
+  double wanted = getSphereSize() * pixelsPerUnit;
+  unsigned atoms = protein.getTopology()->getAtoms().size();
+  if (atoms) wanted = std::min(wanted, sqrt(maxSphereVertices / atoms));
+
+  auto it = details.find(&view.getTile());
+  if (it == details.end())
+    it = details.insert(make_pair(&view.getTile(), DetailSelector(
+      vector<unsigned>(sphereSlices, sphereSlices + detailLevels)))).first;
+
+  unsigned level = it->second.select(wanted, getDrawTime(view),
+                                     view.getFrameBudget());
+
+  sphere = spheres[level];
+  cylinder = cylinders[level];
+}
+
+
+void BasicViewer::cull(const Protein &protein) {
+  if (!culling) {
+    culler.disable();
+    return;
+  }
+
+  const Positions &positions = *protein.getPositions();
+  const Topology::atoms_t &atoms = protein.getTopology()->getAtoms();
+
+  float projection[16];
+  float modelview[16];
+  glGetFloatv(GL_PROJECTION_MATRIX, projection);
+  glGetFloatv(GL_MODELVIEW_MATRIX, modelview);
+
+  culler.begin(projection, modelview, atoms.size());
+  if (!culler.isEnabled()) return;
+
+  double sphereSize = getSphereSize();
+  for (unsigned i = 0; i < atoms.size(); i++)
+    culler.add(i, getPosition(positions, i),
+               sphereSize * getAtomScale(atoms[i]));
+
+  // Only solid spheres hide what is behind them
+  culler.cull(occlusion && isSpaceFilledMode());
+}
+
+
 void BasicViewer::drawProtein(const Protein &protein, const View &view) {
   glFrontFace(GL_CW);
   glEnable(GL_LIGHTING);
@@ -333,11 +670,21 @@ void BasicViewer::drawProtein(const Protein &protein, const View &view) {
   glDepthMask(GL_TRUE);
 
   setupPerspective(view, protein.getRadius());
+  selectDetail(protein, view);
+  cull(protein);
 
   // Draw
   drawAtoms(protein);
   drawBonds(protein);
 
+  if (culler.isEnabled()) {
+    const Culler::Stats &stats = culler.getStats();
+    LOG_DEBUG(5, "Atoms drawn=" << stats.drawnAtoms << " culled="
+              << stats.culledAtoms << " occluded=" << stats.occludedAtoms
+              << " bonds drawn=" << stats.drawnBonds << " culled="
+              << stats.culledBonds);
+  }
+
   // Cean up
   glPopMatrix();
   glDisable(GL_DEPTH_TEST);
@@ -346,14 +693,16 @@ void BasicViewer::drawProtein(const Protein &protein, const View &view) {
 }
 
 
-void BasicViewer::drawInfo(const SimulationInfo &info, const View &view) {
+void BasicViewer::drawInfo(const SimulationInfo &info, const View &view,
+                           bool snapshots) {
   if (!view.getShowInfo()) return;
 
   glDisable(GL_LIGHTING);
 
   // Draw the small callout text
   resetDraw(view);
-  glTranslatef(view.getWidth() - 264, view.getHeight() - 124, 0);
+  glTranslatef(view.getViewportWidth() - 264,
+               view.getViewportHeight() - 124, 0);
 
   box.draw(260, 120);
 
@@ -378,7 +727,6 @@ void BasicViewer::drawInfo(const SimulationInfo &info, const View &view) {
 
   glColor3ub(0x9, 0xa7, 0xb7);
   print(12, 88, "Snapshots:");
-  print(126, 88, view.getFrameDescription());
 
   print(12, 66, "Connection:");
   print(126, 66, view.getConnectionStatus());
@@ -391,7 +739,7 @@ void BasicViewer::drawInfo(const SimulationInfo &info, const View &view) {
 
   // Draw the large callout text
   resetDraw(view);
-  glTranslatef(4, view.getHeight() - 146, 0);
+  glTranslatef(4, view.getViewportHeight() - 146, 0);
 
   box.draw(530, 142);
 
@@ -443,6 +791,22 @@ void BasicViewer::drawInfo(const SimulationInfo &info, const View &view) {
   print(12, 18, "Time Left:");
   if (info.eta) print(140, 18, SSTR(TimeInterval(info.eta)));
 
+  if (snapshots) drawSnapshots(view);
+
+  CHECK_GL_ERROR("");
+}
+
+
+void BasicViewer::drawSnapshots(const View &view) {
+  if (!view.getShowInfo()) return;
+
+  // Goes in the status callout
+  resetDraw(view);
+  glTranslatef(4, 4, 0);
+
+  glColor3ub(0x9, 0xa7, 0xb7);
+  print(126, 88, view.getFrameDescription());
+
   CHECK_GL_ERROR("");
 }
 
@@ -457,10 +821,11 @@ void BasicViewer::drawButtons(const View &view) {
     if (maxWidth < buttons[i]->getWidth())
       maxWidth = buttons[i]->getWidth();
 
-  float xOffset = view.getWidth() - maxWidth - spacing;
+  float xOffset = view.getViewportWidth() - maxWidth - spacing;
   if (xOffset < 0) xOffset = 0;
 
-  float yOffset = view.getHeight() - 120; // view.getHeight() - small box height
+  // Viewport height - small box height
+  float yOffset = view.getViewportHeight() - 120;
   if (yOffset < 0) yOffset = 0;
 
   glDisable(GL_LIGHTING);
@@ -468,12 +833,12 @@ void BasicViewer::drawButtons(const View &view) {
 
   for (unsigned i = 0; i < buttons.size(); i++) {
     float x = (maxWidth - buttons[i]->getWidth()) / 2 + 2;
-    Vector2D min(x + xOffset, view.getHeight() - yOffset);
+    Vector2D min(x + xOffset, view.getViewportHeight() - yOffset);
 
     yOffset -= buttons[i]->getHeight() + spacing;
 
     Vector2D max(x + xOffset + buttons[i]->getWidth(),
-                 view.getHeight() - yOffset);
+                 view.getViewportHeight() - yOffset);
     Rectangle2D bounds(min, max);
 
     picker.set(buttons[i]->getName(), bounds);
@@ -521,26 +886,29 @@ void BasicViewer::drawPopup(const View &view, float width, float height,
   float xMargin, yMargin;
   float scale = 1;
 
-  if (view.getWidth() - width < 0 || view.getHeight() - height < 0) {
-    float xScale = view.getWidth() / width;
-    float yScale = view.getHeight() / height;
+  if (view.getViewportWidth() - width < 0 ||
+      view.getViewportHeight() - height < 0) {
+    float xScale = view.getViewportWidth() / width;
+    float yScale = view.getViewportHeight() / height;
 
     if (xScale < yScale) {
       scale = xScale;
       xMargin = 0;
-      yMargin = Math::round((view.getHeight() - height * scale) / 2 / scale);
+      yMargin = Math::round((view.getViewportHeight() - height * scale) / 2 /
+                            scale);
 
     } else {
       scale = yScale;
-      xMargin = Math::round((view.getWidth() - width * scale) / 2 / scale);
+      xMargin = Math::round((view.getViewportWidth() - width * scale) / 2 /
+                            scale);
       yMargin = 0;
     }
 
     glScalef(scale, scale, 0);
 
   } else {
-    xMargin = Math::round((view.getWidth() - width) / 2);
-    yMargin = Math::round((view.getHeight() - height) / 2);
+    xMargin = Math::round((view.getViewportWidth() - width) / 2);
+    yMargin = Math::round((view.getViewportHeight() - height) / 2);
   }
 
   // Draw box
@@ -651,7 +1019,7 @@ void BasicViewer::drawAbout(const View &view) {
   float y = 16;
 
   // Draw
-  drawPopup(view, width, view.getHeight() * 0.8, height);
+  drawPopup(view, width, view.getViewportHeight() * 0.8, height);
 
   glColor3ub(0x73, 0x96, 0xcf);
   fontBold->print(0, -y, "About the Folding@home Viewer", (unsigned)width);
@@ -693,7 +1061,7 @@ void BasicViewer::drawTextPopup(const View &view, const string &title,
   float width = max(titleDims.x(), textDims.x());
   float height = titleDims.y() + textDims.y();
 
-  drawPopup(view, width, view.getHeight() * 0.8, height);
+  drawPopup(view, width, view.getViewportHeight() * 0.8, height);
 
   glColor3ub(0x98, 0xb8, 0xd6);
   fontBold->print(0, -16, title, (unsigned)width);
@@ -714,19 +1082,77 @@ void BasicViewer::drawBackground(const View &view) {
   glDisable(GL_DEPTH_TEST);
 
   // Draw background
-  view.getBGTexture()->draw(0, 0, view.getWidth(), view.getHeight());
+  view.getBGTexture()->draw(0, 0, view.getViewportWidth(),
+                            view.getViewportHeight());
 
   CHECK_GL_ERROR("");
 }
 
 
+string BasicViewer::getOverlayKey(const SimulationInfo &info,
+                                  const View &view) {
+  ostringstream key;
+
+  key << view.getViewportWidth() << 'x' << view.getViewportHeight();
+
+  if (view.getShowButtons())
+    key << "\nbuttons " << picker.pick(view.getMousePosition());
+
+  if (view.getShowInfo())
+    key << '\n' << info.user << '\n' << info.team << '\n' << info.project
+        << ' ' << info.run << ' ' << info.clone << ' ' << info.gen << '\n'
+        << info.core << ' ' << info.coreType << '\n' << info.progress << ' '
+        << info.iterationsDone << ' ' << info.totalIterations << '\n'
+        << info.eta << '\n' << info.slot << '\n'
+        << view.getConnectionStatus() << '\n' << view.getStatus();
+
+  return key.str();
+}
+
+
+void BasicViewer::drawOverlay(const SimulationInfo &info, const View &view) {
+  if (!view.getShowButtons() && !view.getShowInfo()) return;
+
+  unsigned width = view.getViewportWidth();
+  unsigned height = view.getViewportHeight();
+  string key = getOverlayKey(info, view);
+  Overlay &overlay = overlays[&view.getTile()];
+
+  if (overlay.isDirty(key, width, height)) {
+    overlay.begin(width, height);
+    drawButtons(view);
+    drawInfo(info, view, false);
+    overlay.end(key);
+  }
+
+  resetDraw(view);
+  overlay.draw();
+
+  // Drawn live on top of the cached boxes
+  drawSnapshots(view);
+}
+
+
 void BasicViewer::drawRest(const SimulationInfo &info, const View &view) {
-  // Draw buttons
-  drawButtons(view);
+  // Buttons and simulation info are only redrawn when they change
+  bool drawn = false;
+  if (overlaySupported)
+    try {
+      drawOverlay(info, view);
+      drawn = true;
+    } CATCH_WARNING;
+
+  if (!drawn) {
+    overlaySupported = false;
+    drawButtons(view);
+    drawInfo(info, view);
+  }
+
+  drawPopups(view);
+}
 
-  // Draw simulation info
-  drawInfo(info, view);
 
+void BasicViewer::drawPopups(const View &view) {
   if (view.getShowAbout()) drawAbout(view);
   if (view.getShowHelp()) {
     const char *helpText = FAH::Viewer::resource0.get("help.txt").getData();
@@ -776,18 +1202,40 @@ void BasicViewer::init(ViewMode mode) {
   glMaterialfv(GL_FRONT, GL_SPECULAR, front_specular);
   glDrawBuffer(GL_BACK);
 
-  // Create atom sphere
-  double sphereSize = 1;
-  switch (mode % 3) {
-  case MODE_SPACE_FILLED: sphereSize = SPHERE_SIZE; break;
-  case MODE_BALL_AND_STICK: sphereSize = SPHERE_SIZE_SMALL; break;
-  case MODE_STICK: sphereSize = SPHERE_SIZE_TINY; break;
+  // Create atom spheres and bond cylinders at each level of detail
+  spheres.clear();
+  cylinders.clear();
+  details.clear();
+
+  for (unsigned i = 0; i < detailLevels; i++) {
+    spheres.push_back
+      (new SphereVBO(Vector3D(), getSphereSize(), sphereSlices[i], true));
+    cylinders.push_back(new CylinderVBO(BOND_RADIUS, BOND_RADIUS, 1,
+                                        cylinderSlices[i], 2, true));
   }
 
-  sphere = new SphereVBO(Vector3D(), sphereSize, SUBDIVISIONS, true);
+  sphere = spheres.back();
+  cylinder = cylinders.back();
+
+  // Instanced atoms, falls back to drawing one atom at a time
+  instancer = 0;
+  if (SphereInstancer::isSupported())
+    try {
+      instancer = new SphereInstancer;
+    } CATCH_WARNING;
+
+  // Likewise for bonds
+  bondInstancer = 0;
+  if (CylinderInstancer::isSupported())
+    try {
+      bondInstancer = new CylinderInstancer;
+    } CATCH_WARNING;
+
+  overlaySupported = Overlay::isSupported();
+  overlays.clear();
 
-  // Create bond cylinder
-  cylinder = new CylinderVBO(BOND_RADIUS, BOND_RADIUS, 1, 10, 2, true);
+  timerSupported = GPUTimer::isSupported();
+  timers.clear();
 
   // Load textures
   box.load();
@@ -808,6 +1256,18 @@ void BasicViewer::release() {
   // Release textures
   box.release();
 
+  instancer = 0;
+  bondInstancer = 0;
+
+  overlays.clear();
+
+  sphere = 0;
+  cylinder = 0;
+  spheres.clear();
+  cylinders.clear();
+  details.clear();
+  timers.clear();
+
   initialized = false;
 
   CHECK_GL_ERROR("");
@@ -816,6 +1276,14 @@ void BasicViewer::release() {
 
 void BasicViewer::draw(const SimulationInfo &info, const Protein *protein,
                        const View &view) {
+  wiggle = view.getWiggle();
+  wiggleTick = view.getWiggleTick();
+  instancing = view.getInstancing();
+  culling = view.getCulling();
+  occlusion = view.getOcclusion();
+
+  beginTiming(view);
+
   // Draw background
   drawBackground(view);
 
@@ -824,6 +1292,8 @@ void BasicViewer::draw(const SimulationInfo &info, const Protein *protein,
 
   // Draw rest
   drawRest(info, view);
+
+  endTiming(view);
 }
 
 
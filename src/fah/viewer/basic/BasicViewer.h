@@ -41,10 +41,18 @@
 #include "Box.h"
 #include "Picker.h"
 #include "SphereVBO.h"
+#include "SphereInstancer.h"
 #include "CylinderVBO.h"
+#include "CylinderInstancer.h"
+#include "DetailSelector.h"
+#include "Culler.h"
+#include "Overlay.h"
+#include "GPUTimer.h"
 
 #include <string>
 #include <utility>
+#include <vector>
+#include <map>
 
 #define SUBDIVISIONS 32
 #define SPHERE_SIZE 1.0
@@ -53,6 +61,8 @@
 #define BOND_RADIUS 0.2
 
 namespace FAH {
+  class Tile;
+
   class BasicViewer : public ViewerBase {
   protected:
     ViewMode mode;
@@ -61,8 +71,19 @@ namespace FAH {
     GLFreeType *font;
     GLFreeType *fontBold;
 
-    cb::SmartPointer<SphereVBO> sphere;
-    cb::SmartPointer<CylinderVBO> cylinder;
+    /// Tessellation levels, coarsest first
+    std::vector<cb::SmartPointer<SphereVBO> > spheres;
+    std::vector<cb::SmartPointer<CylinderVBO> > cylinders;
+    std::map<const Tile *, DetailSelector> details;
+    bool timerSupported;
+    std::map<const Tile *, GPUTimer> timers; ///< GPU time spent on each tile
+
+    cb::SmartPointer<SphereVBO> sphere;     ///< The selected sphere level
+    cb::SmartPointer<CylinderVBO> cylinder; ///< The selected cylinder level
+    cb::SmartPointer<SphereInstancer> instancer;
+    std::vector<SphereInstancer::Instance> instances;
+    cb::SmartPointer<CylinderInstancer> bondInstancer;
+    std::vector<CylinderInstancer::Instance> bondInstances;
 
     Box box;
     Box darkBox;
@@ -71,6 +92,22 @@ namespace FAH {
     Texture fahLogo;
 
     Picker picker;
+    bool overlaySupported;
+    std::map<const Tile *, Overlay> overlays; ///< Info boxes and buttons
+    Culler culler;
+
+    /// Atom indices grouped by material, rebuilt when the topology changes
+    const Topology *batchTopology;
+    uint64_t batchTS;
+    std::vector<unsigned> batchOrder;
+    std::vector<unsigned> batchStart; ///< Offset of each material's atoms
+
+    bool wiggle;
+    uint32_t wiggleTick;
+    bool instancing;
+    bool batching;
+    bool culling;
+    bool occlusion;
 
     float popupYOffset;
     float popupPageHeight;
@@ -91,15 +128,46 @@ namespace FAH {
     virtual void setupShadow(const cb::Vector3D &coord,
                              const cb::AxisAngleD &angle) {}
     virtual void drawAtom(const Atom &atom, const cb::Vector3D &position);
+    /// Draws the atom sphere with the current material
+    void drawSphere(const Atom &atom, const cb::Vector3D &position);
     virtual void drawBond(const Protein &protein, const Bond &bond);
+    virtual void drawAtoms(const Protein &protein);
+    virtual void drawBonds(const Protein &protein);
+
+    bool isSpaceFilledMode() const;
+    bool isStickMode() const;
+    double getSphereSize() const;
+    float getAtomScale(const Atom &atom) const;
+
+    /// Gets the element material.  specular[3] holds the shininess.
+    static void getMaterial(const Atom &atom, float diffuse[4],
+                            float specular[4]);
+
+    /// @return the position of atom @param i including any wiggle
+    cb::Vector3D getPosition(const Positions &positions, unsigned i) const;
 
     void drawCuboid(const cb::Rectangle3D &r);
     void drawBox(const Positions &positions);
-    void drawAtoms(const Protein &protein);
-    void drawBonds(const Protein &protein);
+    void updateBatches(const Topology &topology);
+    void drawAtomsBatched(const Protein &protein);
+    void drawAtomsInstanced(const Protein &protein);
+    void drawBondsInstanced(const Protein &protein);
     void setupPerspective(const View &view, double radius);
+    /// Brackets the GL commands for the tile being drawn
+    void beginTiming(const View &view);
+    void endTiming(const View &view);
+    /// @return seconds the GPU spent on the tile's previous frame
+    double getDrawTime(const View &view) const;
+    /// Picks the sphere and cylinder tessellation for the tile being drawn
+    void selectDetail(const Protein &protein, const View &view);
+    /// Finds the atoms visible with the current GL matrices
+    void cull(const Protein &protein);
     void drawProtein(const Protein &protein, const View &view);
-    void drawInfo(const SimulationInfo &info, const View &view);
+    /// @param snapshots false to leave out the frame counter, which changes
+    /// on nearly every frame
+    void drawInfo(const SimulationInfo &info, const View &view,
+                  bool snapshots = true);
+    void drawSnapshots(const View &view);
     void drawButtons(const View &view);
     void drawBackground(const View &view);
     void drawPopup(const View &view, float width, float height,
@@ -107,6 +175,9 @@ namespace FAH {
     void drawAbout(const View &view);
     void drawTextPopup(const View &view, const std::string &title,
                        const std::string &text);
+    /// @return a description of everything the cached overlay shows
+    std::string getOverlayKey(const SimulationInfo &info, const View &view);
+    void drawOverlay(const SimulationInfo &info, const View &view);
     void drawRest(const SimulationInfo &info, const View &view);
 
     void lineUp(unsigned count = 1) {popupYOffset -= count * popupLineHeight;}
@@ -119,6 +190,7 @@ namespace FAH {
     void draw(const SimulationInfo &info, const Protein *protein,
               const View &view);
     void resize(const View &view);
+    void drawPopups(const View &view);
     std::string pick(const cb::Vector2D &p);
 
     static cb::Vector2D project(const cb::Vector2D &v);
@@ -0,0 +1,294 @@
+/******************************************************************************\
+
+                       This file is part of the FAHViewer.
+
+            The FAHViewer displays 3D views of Folding@home proteins.
+                    Copyright (c) 2016-2020, foldingathome.org
+                   Copyright (c) 2003-2016, Stanford University
+                               All rights reserved.
+
+       This program is free software; you can redistribute it and/or modify
+       it under the terms of the GNU General Public License as published by
+        the Free Software Foundation; either version 2 of the License, or
+                       (at your option) any later version.
+
+         This program is distributed in the hope that it will be useful,
+          but WITHOUT ANY WARRANTY; without even the implied warranty of
+          MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+                   GNU General Public License for more details.
+
+     You should have received a copy of the GNU General Public License along
+     with this program; if not, write to the Free Software Foundation, Inc.,
+           51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+                  For information regarding this software email:
+                                 Joseph Coffland
+                          joseph@cauldrondevelopment.com
+
+\******************************************************************************/
+
+
+#include "Culler.h"
+
+#include <algorithm>
+#include <limits>
+#include <cmath>
+
+using namespace std;
+using namespace cb;
+using namespace FAH;
+
+
+namespace {
+  const double minCellSize = 8;   ///< Angstroms
+  const unsigned maxCells = 32;   ///< Grid cells along the longest axis
+  const unsigned occlusionSize = 64; ///< Occlusion buffer width & height
+}
+
+
+void Culler::begin(const float projection[16], const float modelview[16],
+                   unsigned atoms) {
+  stats = Stats();
+
+  // Spheres project to ellipses only under an orthographic projection
+  enabled = !projection[3] && !projection[7] && !projection[11] &&
+    projection[15] == 1;
+  if (!enabled) return;
+
+  for (unsigned col = 0; col < 4; col++)
+    for (unsigned row = 0; row < 4; row++) {
+      double sum = 0;
+      for (unsigned k = 0; k < 4; k++)
+        sum += projection[k * 4 + row] * modelview[col * 4 + k];
+      matrix[col * 4 + row] = sum;
+    }
+
+  for (unsigned i = 0; i < 3; i++)
+    scale[i] = sqrt(matrix[i] * matrix[i] + matrix[4 + i] * matrix[4 + i] +
+                    matrix[8 + i] * matrix[8 + i]);
+
+  spheres.resize(atoms * 4);
+  visible.assign(atoms, 0);
+  maxRadius = 0;
+}
+
+
+void Culler::disable() {
+  enabled = false;
+  stats = Stats();
+}
+
+
+void Culler::add(unsigned atom, const Vector3D &p, double radius) {
+  float *s = &spheres[atom * 4];
+  s[0] = p.x();
+  s[1] = p.y();
+  s[2] = p.z();
+  s[3] = radius;
+
+  if (maxRadius < radius) maxRadius = radius;
+}
+
+
+void Culler::cull(bool occlude) {
+  if (!enabled) return;
+
+  unsigned count = visible.size();
+  if (!count) return;
+
+  buildGrid(count);
+  cullFrustum(count);
+  if (occlude) this->occlude(count);
+
+  for (unsigned i = 0; i < count; i++)
+    if (visible[i]) stats.drawnAtoms++;
+  stats.culledAtoms = count - stats.drawnAtoms - stats.occludedAtoms;
+}
+
+
+bool Culler::isVisible(const Vector3D &left, const Vector3D &right,
+                       double radius) {
+  if (!enabled) return true;
+
+  // Test the sphere around the bond
+  const Vector3D mid = (left + right) / 2.0;
+  const float p[3] = {(float)mid.x(), (float)mid.y(), (float)mid.z()};
+  double ndc[3];
+  transform(p, ndc);
+
+  if (inFrustum(ndc, left.distance(right) / 2 + radius)) {
+    stats.drawnBonds++;
+    return true;
+  }
+
+  stats.culledBonds++;
+  return false;
+}
+
+
+void Culler::transform(const float *p, double out[3]) const {
+  for (unsigned i = 0; i < 3; i++)
+    out[i] = matrix[i] * p[0] + matrix[4 + i] * p[1] + matrix[8 + i] * p[2] +
+      matrix[12 + i];
+}
+
+
+bool Culler::inFrustum(const double ndc[3], double radius) const {
+  for (unsigned i = 0; i < 3; i++)
+    if (1 + radius * scale[i] < fabs(ndc[i])) return false;
+
+  return true;
+}
+
+
+void Culler::buildGrid(unsigned count) {
+  double bounds[2][3];
+  for (unsigned i = 0; i < 3; i++) {
+    bounds[0][i] = numeric_limits<double>::max();
+    bounds[1][i] = -numeric_limits<double>::max();
+  }
+
+  for (unsigned i = 0; i < count; i++)
+    for (unsigned j = 0; j < 3; j++) {
+      double x = spheres[i * 4 + j];
+      if (x < bounds[0][j]) bounds[0][j] = x;
+      if (bounds[1][j] < x) bounds[1][j] = x;
+    }
+
+  double extent = 0;
+  for (unsigned i = 0; i < 3; i++)
+    extent = max(extent, bounds[1][i] - bounds[0][i]);
+
+  cellSize = max(minCellSize, extent / maxCells);
+  gridMin = Vector3D(bounds[0][0], bounds[0][1], bounds[0][2]);
+  for (unsigned i = 0; i < 3; i++)
+    dims[i] = (unsigned)((bounds[1][i] - bounds[0][i]) / cellSize) + 1;
+
+  // Counting sort of the atoms by cell
+  unsigned cells = dims[0] * dims[1] * dims[2];
+  cellStart.assign(cells + 1, 0);
+  cellAtoms.resize(count);
+
+  vector<unsigned> index(count);
+
+  for (unsigned i = 0; i < count; i++) {
+    unsigned c[3];
+    for (unsigned j = 0; j < 3; j++)
+      c[j] = min(dims[j] - 1, (unsigned)
+                 ((spheres[i * 4 + j] - gridMin[j]) / cellSize));
+
+    index[i] = (c[2] * dims[1] + c[1]) * dims[0] + c[0];
+    cellStart[index[i] + 1]++;
+  }
+
+  for (unsigned i = 0; i < cells; i++) cellStart[i + 1] += cellStart[i];
+
+  vector<unsigned> next(cellStart.begin(), cellStart.end() - 1);
+  for (unsigned i = 0; i < count; i++) cellAtoms[next[index[i]]++] = i;
+}
+
+
+void Culler::cullFrustum(unsigned count) {
+  // Cell bounds grow by the largest atom so every atom fits its cell's box
+  double half = cellSize / 2 + maxRadius;
+  double extent[3];
+  for (unsigned i = 0; i < 3; i++)
+    extent[i] = half * (fabs(matrix[i]) + fabs(matrix[4 + i]) +
+                        fabs(matrix[8 + i]));
+
+  for (unsigned z = 0; z < dims[2]; z++)
+    for (unsigned y = 0; y < dims[1]; y++)
+      for (unsigned x = 0; x < dims[0]; x++) {
+        unsigned cell = (z * dims[1] + y) * dims[0] + x;
+        unsigned start = cellStart[cell];
+        unsigned end = cellStart[cell + 1];
+        if (start == end) continue;
+
+        const float center[3] = {
+          (float)(gridMin.x() + (x + 0.5) * cellSize),
+          (float)(gridMin.y() + (y + 0.5) * cellSize),
+          (float)(gridMin.z() + (z + 0.5) * cellSize),
+        };
+        double ndc[3];
+        transform(center, ndc);
+
+        bool outside = false;
+        bool inside = true;
+        for (unsigned i = 0; i < 3; i++) {
+          if (1 < fabs(ndc[i]) - extent[i]) outside = true;
+          if (1 < fabs(ndc[i]) + extent[i]) inside = false;
+        }
+
+        if (outside) continue;
+
+        for (unsigned i = start; i < end; i++) {
+          unsigned atom = cellAtoms[i];
+
+          if (inside) visible[atom] = true;
+          else {
+            transform(&spheres[atom * 4], ndc);
+            visible[atom] = inFrustum(ndc, spheres[atom * 4 + 3]);
+          }
+        }
+      }
+}
+
+
+void Culler::occlude(unsigned count) {
+  const unsigned size = occlusionSize;
+  const double toCell = size / 2.0;
+
+  depths.assign(size * size, numeric_limits<float>::infinity());
+
+  // Each atom covers the rectangle inscribed in its projected ellipse with
+  // a surface no farther than its center
+  for (unsigned i = 0; i < count; i++) {
+    if (!visible[i]) continue;
+
+    double ndc[3];
+    transform(&spheres[i * 4], ndc);
+
+    // Atoms cut by the near plane leave holes
+    if (ndc[2] - spheres[i * 4 + 3] * scale[2] < -1) continue;
+    double r = spheres[i * 4 + 3] * M_SQRT1_2;
+
+    int x0 = max(0, (int)ceil((ndc[0] - r * scale[0] + 1) * toCell));
+    int x1 = min((int)size, (int)floor((ndc[0] + r * scale[0] + 1) * toCell));
+    int y0 = max(0, (int)ceil((ndc[1] - r * scale[1] + 1) * toCell));
+    int y1 = min((int)size, (int)floor((ndc[1] + r * scale[1] + 1) * toCell));
+
+    for (int y = y0; y < y1; y++)
+      for (int x = x0; x < x1; x++) {
+        float &depth = depths[y * size + x];
+        if (ndc[2] < depth) depth = ndc[2];
+      }
+  }
+
+  // An atom is hidden if every cell it touches is covered in front of it
+  for (unsigned i = 0; i < count; i++) {
+    if (!visible[i]) continue;
+
+    double ndc[3];
+    transform(&spheres[i * 4], ndc);
+    double r = spheres[i * 4 + 3];
+    double nearest = ndc[2] - r * scale[2];
+
+    int x0 = max(0, (int)floor((ndc[0] - r * scale[0] + 1) * toCell));
+    int x1 = min((int)size - 1,
+                 (int)floor((ndc[0] + r * scale[0] + 1) * toCell));
+    int y0 = max(0, (int)floor((ndc[1] - r * scale[1] + 1) * toCell));
+    int y1 = min((int)size - 1,
+                 (int)floor((ndc[1] + r * scale[1] + 1) * toCell));
+    if (x1 < x0 || y1 < y0) continue;
+
+    bool hidden = true;
+    for (int y = y0; y <= y1 && hidden; y++)
+      for (int x = x0; x <= x1 && hidden; x++)
+        if (nearest <= depths[y * size + x]) hidden = false;
+
+    if (hidden) {
+      visible[i] = false;
+      stats.occludedAtoms++;
+    }
+  }
+}
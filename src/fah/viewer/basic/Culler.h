@@ -0,0 +1,103 @@
+/******************************************************************************\
+
+                       This file is part of the FAHViewer.
+
+            The FAHViewer displays 3D views of Folding@home proteins.
+                    Copyright (c) 2016-2020, foldingathome.org
+                   Copyright (c) 2003-2016, Stanford University
+                               All rights reserved.
+
+       This program is free software; you can redistribute it and/or modify
+       it under the terms of the GNU General Public License as published by
+        the Free Software Foundation; either version 2 of the License, or
+                       (at your option) any later version.
+
+         This program is distributed in the hope that it will be useful,
+          but WITHOUT ANY WARRANTY; without even the implied warranty of
+          MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+                   GNU General Public License for more details.
+
+     You should have received a copy of the GNU General Public License along
+     with this program; if not, write to the Free Software Foundation, Inc.,
+           51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+                  For information regarding this software email:
+                                 Joseph Coffland
+                          joseph@cauldrondevelopment.com
+
+\******************************************************************************/
+
+
+#pragma once
+
+#include <cbang/geom/Vector.h>
+
+#include <vector>
+#include <cstdint>
+
+
+namespace FAH {
+  /// Decides which atoms and bonds can be seen before they are drawn.
+  /// Atoms are binned into a uniform grid each frame so whole cells outside
+  /// the view volume are rejected at once.  Optionally a coarse screen space
+  /// depth buffer rejects atoms hidden behind nearer atoms.  Only
+  /// orthographic projections are culled, anything else draws everything.
+  class Culler {
+  public:
+    struct Stats {
+      unsigned drawnAtoms;
+      unsigned culledAtoms;   ///< Outside the view volume
+      unsigned occludedAtoms; ///< Hidden behind nearer atoms
+      unsigned drawnBonds;
+      unsigned culledBonds;
+    };
+
+  protected:
+    bool enabled = false;
+
+    double matrix[16]; ///< World to normalized device coordinates
+    double scale[3];   ///< Device units per world unit along each axis
+
+    std::vector<float> spheres; ///< x, y, z & radius of each atom
+    std::vector<uint8_t> visible;
+    float maxRadius = 0;
+
+    // Uniform grid
+    cb::Vector3D gridMin;
+    double cellSize = 0;
+    unsigned dims[3];
+    std::vector<unsigned> cellStart;
+    std::vector<unsigned> cellAtoms;
+
+    // Occlusion buffer, the depth behind which a cell is fully covered
+    std::vector<float> depths;
+
+    Stats stats;
+
+  public:
+    /// Start a frame with the current GL matrices
+    void begin(const float projection[16], const float modelview[16],
+               unsigned atoms);
+    /// Draw everything this frame
+    void disable();
+    bool isEnabled() const {return enabled;}
+
+    void add(unsigned atom, const cb::Vector3D &p, double radius);
+    /// Classify the atoms added since begin()
+    void cull(bool occlude);
+
+    bool isVisible(unsigned atom) const {return !enabled || visible[atom];}
+    /// Tests and counts a bond
+    bool isVisible(const cb::Vector3D &left, const cb::Vector3D &right,
+                   double radius);
+
+    const Stats &getStats() const {return stats;}
+
+  protected:
+    void transform(const float *p, double out[3]) const;
+    bool inFrustum(const double ndc[3], double radius) const;
+    void buildGrid(unsigned count);
+    void cullFrustum(unsigned count);
+    void occlude(unsigned count);
+  };
+}
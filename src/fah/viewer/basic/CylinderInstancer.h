@@ -0,0 +1,73 @@
+/******************************************************************************\
+
+                       This file is part of the FAHViewer.
+
+            The FAHViewer displays 3D views of Folding@home proteins.
+                    Copyright (c) 2016-2020, foldingathome.org
+                   Copyright (c) 2003-2016, Stanford University
+                               All rights reserved.
+
+       This program is free software; you can redistribute it and/or modify
+       it under the terms of the GNU General Public License as published by
+        the Free Software Foundation; either version 2 of the License, or
+                       (at your option) any later version.
+
+         This program is distributed in the hope that it will be useful,
+          but WITHOUT ANY WARRANTY; without even the implied warranty of
+          MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+                   GNU General Public License for more details.
+
+     You should have received a copy of the GNU General Public License along
+     with this program; if not, write to the Free Software Foundation, Inc.,
+           51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+                  For information regarding this software email:
+                                 Joseph Coffland
+                          joseph@cauldrondevelopment.com
+
+\******************************************************************************/
+
+
+#pragma once
+
+#include "ShaderProgram.h"
+
+#include <cbang/SmartPointer.h>
+
+#include <vector>
+
+
+namespace FAH {
+  class CylinderVBO;
+
+  /// Draws many copies of the unit bond cylinder with a single instanced
+  /// draw call.  Each instance carries a precomputed transform, which maps
+  /// the cylinder's z axis onto the bond, and its own material.
+  class CylinderInstancer {
+    cb::SmartPointer<ShaderProgram> program;
+    unsigned buffer;
+
+    int originAttrib;
+    int axisAttrib;
+    int sideAttrib;
+    int diffuseAttrib;
+    int specularAttrib;
+
+  public:
+    struct Instance {
+      float origin[4];   ///< xyz start of the cylinder, w unused
+      float axis[4];     ///< xyz direction scaled by length, w unused
+      float side[4];     ///< xyz unit vector perpendicular to axis, w unused
+      float diffuse[4];
+      float specular[4]; ///< rgb specular, a shininess
+    };
+
+    CylinderInstancer();
+    ~CylinderInstancer();
+
+    /// @return true if the GL context supports instanced drawing
+    static bool isSupported();
+
+    void draw(CylinderVBO &cylinder, const std::vector<Instance> &instances);
+  };
+}
@@ -160,3 +160,8 @@ CylinderVBO::CylinderVBO(float baseRadius, float topRadius, float length,
 void CylinderVBO::draw() {
   glDrawArrays(GL_TRIANGLES, 0, stacks * slices * 6);
 }
+
+
+void CylinderVBO::drawInstanced(unsigned count) {
+  glDrawArraysInstanced(GL_TRIANGLES, 0, stacks * slices * 6, count);
+}
@@ -40,6 +40,9 @@ namespace FAH {
     CylinderVBO(float baseRadius, float topRadius, float length, int slices,
                 int stacks, bool textured);
 
+    /// Draw @param count instances, requires GL 3.1 or later
+    void drawInstanced(unsigned count);
+
     // From VBO
     void draw();
   };
@@ -0,0 +1,87 @@
+/******************************************************************************\
+
+                       This file is part of the FAHViewer.
+
+            The FAHViewer displays 3D views of Folding@home proteins.
+                    Copyright (c) 2016-2020, foldingathome.org
+                   Copyright (c) 2003-2016, Stanford University
+                               All rights reserved.
+
+       This program is free software; you can redistribute it and/or modify
+       it under the terms of the GNU General Public License as published by
+        the Free Software Foundation; either version 2 of the License, or
+                       (at your option) any later version.
+
+         This program is distributed in the hope that it will be useful,
+          but WITHOUT ANY WARRANTY; without even the implied warranty of
+          MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+                   GNU General Public License for more details.
+
+     You should have received a copy of the GNU General Public License along
+     with this program; if not, write to the Free Software Foundation, Inc.,
+           51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+                  For information regarding this software email:
+                                 Joseph Coffland
+                          joseph@cauldrondevelopment.com
+
+\******************************************************************************/
+
+
+#include "DetailSelector.h"
+
+#include <cbang/log/Logger.h>
+
+using namespace std;
+using namespace FAH;
+
+
+namespace {
+  // Hysteresis band around the level boundaries
+  const double stepUp = 1.2;
+  const double stepDown = 0.8;
+
+  // Governor
+  const unsigned slowLimit = 3;   ///< Missed budgets before stepping down
+  const unsigned fastLimit = 100; ///< Fast frames before stepping back up
+}
+
+
+DetailSelector::DetailSelector(const vector<unsigned> &sizes) :
+  sizes(sizes), level(sizes.size() - 1), cap(sizes.size() - 1) {}
+
+
+unsigned DetailSelector::select(double wanted, double frameTime,
+                                double budget) {
+  unsigned n = sizes.size();
+
+  // Step up only once the current level is clearly too coarse and down
+  // only once the next level is clearly fine enough
+  while (level + 1 < n && sizes[level] * stepUp < wanted) level++;
+  while (level && wanted < sizes[level - 1] * stepDown) level--;
+
+  if (budget && frameTime) {
+    if (budget < frameTime) {
+      fastFrames = 0;
+
+      if (slowLimit <= ++slowFrames && cap) {
+        cap--;
+        slowFrames = 0;
+        LOG_DEBUG(3, "Frame took " << frameTime * 1000 << "ms, detail capped "
+                  "at level " << cap);
+      }
+
+    } else if (frameTime < budget / 3) {
+      slowFrames = 0;
+
+      if (fastLimit <= ++fastFrames && cap + 1 < n) {
+        cap++;
+        fastFrames = 0;
+        LOG_DEBUG(3, "Detail cap raised to level " << cap);
+      }
+
+    } else slowFrames = fastFrames = 0;
+  }
+
+  return getLevel();
+}
@@ -0,0 +1,61 @@
+/******************************************************************************\
+
+                       This file is part of the FAHViewer.
+
+            The FAHViewer displays 3D views of Folding@home proteins.
+                    Copyright (c) 2016-2020, foldingathome.org
+                   Copyright (c) 2003-2016, Stanford University
+                               All rights reserved.
+
+       This program is free software; you can redistribute it and/or modify
+       it under the terms of the GNU General Public License as published by
+        the Free Software Foundation; either version 2 of the License, or
+                       (at your option) any later version.
+
+         This program is distributed in the hope that it will be useful,
+          but WITHOUT ANY WARRANTY; without even the implied warranty of
+          MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+                   GNU General Public License for more details.
+
+     You should have received a copy of the GNU General Public License along
+     with this program; if not, write to the Free Software Foundation, Inc.,
+           51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+                  For information regarding this software email:
+                                 Joseph Coffland
+                          joseph@cauldrondevelopment.com
+
+\******************************************************************************/
+
+
+#pragma once
+
+#include <vector>
+
+
+namespace FAH {
+  /// Picks a tessellation level each frame.  The level follows the detail
+  /// the projected size of the geometry calls for, with hysteresis so it
+  /// does not flip between levels as the size hovers near a boundary.  A
+  /// governor caps the level, stepping down when frames miss the render
+  /// budget and back up after a long run of fast frames.
+  class DetailSelector {
+    std::vector<unsigned> sizes; ///< Tessellation of each level, coarsest first
+    unsigned level;
+    unsigned cap;
+    unsigned slowFrames = 0;
+    unsigned fastFrames = 0;
+
+  public:
+    DetailSelector(const std::vector<unsigned> &sizes = {1});
+
+    unsigned getLevel() const {return level < cap ? level : cap;}
+    unsigned getCap() const {return cap;}
+
+    /// @param wanted the tessellation the projected size calls for
+    /// @param frameTime seconds spent drawing the previous frame
+    /// @param budget the time available for a frame, zero for no limit
+    /// @return the level to draw
+    unsigned select(double wanted, double frameTime, double budget);
+  };
+}
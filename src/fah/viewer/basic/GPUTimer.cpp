@@ -0,0 +1,115 @@
+/******************************************************************************\
+
+                       This file is part of the FAHViewer.
+
+            The FAHViewer displays 3D views of Folding@home proteins.
+                    Copyright (c) 2016-2020, foldingathome.org
+                   Copyright (c) 2003-2016, Stanford University
+                               All rights reserved.
+
+       This program is free software; you can redistribute it and/or modify
+       it under the terms of the GNU General Public License as published by
+        the Free Software Foundation; either version 2 of the License, or
+                       (at your option) any later version.
+
+         This program is distributed in the hope that it will be useful,
+          but WITHOUT ANY WARRANTY; without even the implied warranty of
+          MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+                   GNU General Public License for more details.
+
+     You should have received a copy of the GNU General Public License along
+     with this program; if not, write to the Free Software Foundation, Inc.,
+           51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+                  For information regarding this software email:
+                                 Joseph Coffland
+                          joseph@cauldrondevelopment.com
+
+\******************************************************************************/
+
+
+
+#include "GPUTimer.h"
+
+#include <fah/viewer/GL.h>
+
+using namespace std;
+using namespace cb;
+using namespace FAH;
+
+
+GPUTimer::GPUTimer() : next(0), active(false), elapsed(-1) {
+  for (unsigned i = 0; i < QUERIES; i++) {
+    queries[i] = 0;
+    issued[i] = false;
+  }
+}
+
+
+bool GPUTimer::isSupported() {
+  return (GLEW_VERSION_3_3 || GLEW_ARB_timer_query) && glGenQueries &&
+    glBeginQuery && glEndQuery && glGetQueryObjectuiv &&
+    glGetQueryObjectui64v;
+}
+
+
+void GPUTimer::begin() {
+  if (active) end(); // Left open by an exception
+
+  if (!queries[0]) glGenQueries(QUERIES, queries);
+
+  collect();
+  if (issued[next]) return; // The GPU is more than QUERIES frames behind
+
+  glBeginQuery(GL_TIME_ELAPSED, queries[next]);
+  active = true;
+
+  CHECK_GL_ERROR("");
+}
+
+
+void GPUTimer::end() {
+  if (!active) return;
+
+  glEndQuery(GL_TIME_ELAPSED);
+  issued[next] = true;
+  next = (next + 1) % QUERIES;
+  active = false;
+
+  CHECK_GL_ERROR("");
+}
+
+
+void GPUTimer::release() {
+  if (!queries[0]) return;
+
+  if (active) glEndQuery(GL_TIME_ELAPSED);
+  glDeleteQueries(QUERIES, queries);
+
+  for (unsigned i = 0; i < QUERIES; i++) {
+    queries[i] = 0;
+    issued[i] = false;
+  }
+
+  next = 0;
+  active = false;
+}
+
+
+void GPUTimer::collect() {
+  // Oldest first, queries complete in the order they were issued
+  for (unsigned i = 0; i < QUERIES; i++) {
+    unsigned query = (next + i) % QUERIES;
+    if (!issued[query]) continue;
+
+    GLuint available = 0;
+    glGetQueryObjectuiv(queries[query], GL_QUERY_RESULT_AVAILABLE,
+                        &available);
+    if (!available) break;
+
+    GLuint64 ns = 0;
+    glGetQueryObjectui64v(queries[query], GL_QUERY_RESULT, &ns);
+    elapsed = ns * 1e-9;
+    issued[query] = false;
+  }
+}
@@ -0,0 +1,69 @@
+/******************************************************************************\
+
+                       This file is part of the FAHViewer.
+
+            The FAHViewer displays 3D views of Folding@home proteins.
+                    Copyright (c) 2016-2020, foldingathome.org
+                   Copyright (c) 2003-2016, Stanford University
+                               All rights reserved.
+
+       This program is free software; you can redistribute it and/or modify
+       it under the terms of the GNU General Public License as published by
+        the Free Software Foundation; either version 2 of the License, or
+                       (at your option) any later version.
+
+         This program is distributed in the hope that it will be useful,
+          but WITHOUT ANY WARRANTY; without even the implied warranty of
+          MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+                   GNU General Public License for more details.
+
+     You should have received a copy of the GNU General Public License along
+     with this program; if not, write to the Free Software Foundation, Inc.,
+           51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+                  For information regarding this software email:
+                                 Joseph Coffland
+                          joseph@cauldrondevelopment.com
+
+\******************************************************************************/
+
+
+#pragma once
+
+
+namespace FAH {
+  /// Measures how long the GPU spends on the commands issued between
+  /// begin() and end() with GL_TIME_ELAPSED queries.  Results are picked
+  /// up frames later, once the GPU has them, so reading never stalls.
+  class GPUTimer {
+    static const unsigned QUERIES = 3;
+
+    unsigned queries[QUERIES];
+    bool issued[QUERIES];
+    unsigned next;
+    bool active;
+    double elapsed; ///< Seconds, negative until the first result
+
+  public:
+    GPUTimer();
+    ~GPUTimer() {release();}
+
+    GPUTimer(const GPUTimer &) = delete;
+    GPUTimer &operator=(const GPUTimer &) = delete;
+
+    /// @return true if the GL context supports timer queries
+    static bool isSupported();
+
+    bool hasResult() const {return 0 <= elapsed;}
+    /// @return the most recent GPU time in seconds
+    double getElapsed() const {return elapsed;}
+
+    /// Skips timing if every query is still waiting for its result
+    void begin();
+    void end();
+    void release();
+
+  protected:
+    void collect();
+  };
+}
@@ -0,0 +1,154 @@
+/******************************************************************************\
+
+                       This file is part of the FAHViewer.
+
+            The FAHViewer displays 3D views of Folding@home proteins.
+                    Copyright (c) 2016-2020, foldingathome.org
+                   Copyright (c) 2003-2016, Stanford University
+                               All rights reserved.
+
+       This program is free software; you can redistribute it and/or modify
+       it under the terms of the GNU General Public License as published by
+        the Free Software Foundation; either version 2 of the License, or
+                       (at your option) any later version.
+
+         This program is distributed in the hope that it will be useful,
+          but WITHOUT ANY WARRANTY; without even the implied warranty of
+          MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+                   GNU General Public License for more details.
+
+     You should have received a copy of the GNU General Public License along
+     with this program; if not, write to the Free Software Foundation, Inc.,
+           51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+                  For information regarding this software email:
+                                 Joseph Coffland
+                          joseph@cauldrondevelopment.com
+
+\******************************************************************************/
+
+
+#include "Overlay.h"
+
+#include <fah/viewer/GL.h>
+
+#include <cbang/Exception.h>
+
+using namespace std;
+using namespace cb;
+using namespace FAH;
+
+
+Overlay::Overlay() : fbo(0), texture(0), width(0), height(0) {}
+
+
+bool Overlay::isSupported() {
+  return glGenFramebuffersEXT && glBindFramebufferEXT &&
+    glFramebufferTexture2DEXT && glCheckFramebufferStatusEXT &&
+    glBlendFuncSeparate;
+}
+
+
+bool Overlay::isDirty(const string &key, unsigned width,
+                      unsigned height) const {
+  return !texture || this->width != width || this->height != height ||
+    this->key != key;
+}
+
+
+void Overlay::begin(unsigned width, unsigned height) {
+  if (!texture || this->width != width || this->height != height) {
+    release();
+
+    this->width = width;
+    this->height = height;
+
+    // Pixels map one to one onto the viewport
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA,
+                 GL_UNSIGNED_BYTE, 0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    glGenFramebuffersEXT(1, &fbo);
+    glBindFramebufferEXT(GL_FRAMEBUFFER_EXT, fbo);
+    glFramebufferTexture2DEXT(GL_FRAMEBUFFER_EXT, GL_COLOR_ATTACHMENT0_EXT,
+                              GL_TEXTURE_2D, texture, 0);
+
+    GLenum status = glCheckFramebufferStatusEXT(GL_FRAMEBUFFER_EXT);
+    if (status != GL_FRAMEBUFFER_COMPLETE_EXT) {
+      glBindFramebufferEXT(GL_FRAMEBUFFER_EXT, 0);
+      release();
+      THROW("Overlay framebuffer incomplete: 0x" << hex << status);
+    }
+
+  } else glBindFramebufferEXT(GL_FRAMEBUFFER_EXT, fbo);
+
+  key.clear();
+
+  glPushAttrib(GL_VIEWPORT_BIT | GL_SCISSOR_BIT | GL_COLOR_BUFFER_BIT);
+  glViewport(0, 0, width, height);
+  glDisable(GL_SCISSOR_TEST);
+  glClearColor(0, 0, 0, 0);
+  glClear(GL_COLOR_BUFFER_BIT);
+
+  // Store premultiplied color and accumulate coverage in alpha so that
+  // compositing the texture matches drawing the content directly
+  glEnable(GL_BLEND);
+  glBlendFuncSeparate(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_ONE,
+                      GL_ONE_MINUS_SRC_ALPHA);
+
+  CHECK_GL_ERROR("");
+}
+
+
+void Overlay::end(const string &key) {
+  glPopAttrib();
+  glBindFramebufferEXT(GL_FRAMEBUFFER_EXT, 0);
+
+  this->key = key;
+
+  CHECK_GL_ERROR("");
+}
+
+
+void Overlay::draw() const {
+  if (!texture) return;
+
+  glPushAttrib(GL_COLOR_BUFFER_BIT | GL_ENABLE_BIT | GL_CURRENT_BIT |
+               GL_TEXTURE_BIT);
+  glDisable(GL_LIGHTING);
+  glDisable(GL_DEPTH_TEST);
+  glEnable(GL_BLEND);
+  glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+
+  glEnable(GL_TEXTURE_2D);
+  glTexEnvf(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_REPLACE);
+  glBindTexture(GL_TEXTURE_2D, texture);
+  glColor4f(1, 1, 1, 1);
+
+  glBegin(GL_QUADS);
+  glTexCoord2f(0, 0); glVertex2f(0, 0);
+  glTexCoord2f(1, 0); glVertex2f(width, 0);
+  glTexCoord2f(1, 1); glVertex2f(width, height);
+  glTexCoord2f(0, 1); glVertex2f(0, height);
+  glEnd();
+
+  glBindTexture(GL_TEXTURE_2D, 0);
+  glPopAttrib();
+
+  CHECK_GL_ERROR("");
+}
+
+
+void Overlay::release() {
+  if (fbo) glDeleteFramebuffersEXT(1, &fbo);
+  if (texture) glDeleteTextures(1, &texture);
+
+  fbo = texture = 0;
+  key.clear();
+}
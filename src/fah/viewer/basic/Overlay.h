@@ -0,0 +1,70 @@
+/******************************************************************************\
+
+                       This file is part of the FAHViewer.
+
+            The FAHViewer displays 3D views of Folding@home proteins.
+                    Copyright (c) 2016-2020, foldingathome.org
+                   Copyright (c) 2003-2016, Stanford University
+                               All rights reserved.
+
+       This program is free software; you can redistribute it and/or modify
+       it under the terms of the GNU General Public License as published by
+        the Free Software Foundation; either version 2 of the License, or
+                       (at your option) any later version.
+
+         This program is distributed in the hope that it will be useful,
+          but WITHOUT ANY WARRANTY; without even the implied warranty of
+          MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+                   GNU General Public License for more details.
+
+     You should have received a copy of the GNU General Public License along
+     with this program; if not, write to the Free Software Foundation, Inc.,
+           51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+                  For information regarding this software email:
+                                 Joseph Coffland
+                          joseph@cauldrondevelopment.com
+
+\******************************************************************************/
+
+
+#pragma once
+
+#include <string>
+
+
+namespace FAH {
+  /// A screen sized texture holding 2D content which rarely changes.  The
+  /// content is drawn into the texture only when its key changes and is
+  /// otherwise composited with a single quad.
+  class Overlay {
+    unsigned fbo;
+    unsigned texture;
+    unsigned width;
+    unsigned height;
+    std::string key;
+
+  public:
+    Overlay();
+    ~Overlay() {release();}
+
+    Overlay(const Overlay &) = delete;
+    Overlay &operator=(const Overlay &) = delete;
+
+    /// @return true if the GL context supports rendering to a texture
+    static bool isSupported();
+
+    /// @return true if the content described by @param key must be drawn
+    bool isDirty(const std::string &key, unsigned width,
+                 unsigned height) const;
+
+    /// Direct drawing into the texture, cleared to transparent
+    void begin(unsigned width, unsigned height);
+    /// Return to drawing to the screen and remember the content's @param key
+    void end(const std::string &key);
+
+    /// Composite over the current viewport, after resetDraw()
+    void draw() const;
+    void release();
+  };
+}
@@ -0,0 +1,155 @@
+/******************************************************************************\
+
+                       This file is part of the FAHViewer.
+
+            The FAHViewer displays 3D views of Folding@home proteins.
+                    Copyright (c) 2016-2020, foldingathome.org
+                   Copyright (c) 2003-2016, Stanford University
+                               All rights reserved.
+
+       This program is free software; you can redistribute it and/or modify
+       it under the terms of the GNU General Public License as published by
+        the Free Software Foundation; either version 2 of the License, or
+                       (at your option) any later version.
+
+         This program is distributed in the hope that it will be useful,
+          but WITHOUT ANY WARRANTY; without even the implied warranty of
+          MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+                   GNU General Public License for more details.
+
+     You should have received a copy of the GNU General Public License along
+     with this program; if not, write to the Free Software Foundation, Inc.,
+           51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+                  For information regarding this software email:
+                                 Joseph Coffland
+                          joseph@cauldrondevelopment.com
+
+\******************************************************************************/
+
+#include "ShaderProgram.h"
+
+#include <fah/viewer/GL.h>
+
+#include <cbang/Exception.h>
+#include <cbang/util/Resource.h>
+
+using namespace std;
+using namespace cb;
+using namespace FAH;
+
+namespace FAH {
+  namespace Viewer {
+    extern const DirectoryResource resource0;
+  }
+}
+
+
+static string getInfoLog(unsigned handle, bool program) {
+  char log[1000] = "";
+  if (program) glGetProgramInfoLog(handle, 1000, 0, log);
+  else glGetShaderInfoLog(handle, 1000, 0, log);
+  return log;
+}
+
+
+ShaderProgram::ShaderProgram(const string &vertFile, const string &fragFile,
+                             const string &fragLibrary) :
+  program(0), vertShader(0), fragShader(0) {
+  if (!isSupported()) THROW("GLSL programs not supported");
+
+  program = glCreateProgram();
+
+  try {
+    vertShader = loadShader(vertFile, GL_VERTEX_SHADER);
+    fragShader = loadShader(fragFile, GL_FRAGMENT_SHADER, fragLibrary);
+
+    glLinkProgram(program);
+
+    int linkResult = 0;
+    glGetProgramiv(program, GL_LINK_STATUS, &linkResult);
+    if (!linkResult) THROW("Failed to link program " << vertFile << ", "
+                           << fragFile << ": " << getInfoLog(program, true));
+
+  } catch (...) {
+    release();
+    throw;
+  }
+
+  CHECK_GL_ERROR("");
+}
+
+
+ShaderProgram::~ShaderProgram() {
+  release();
+}
+
+
+bool ShaderProgram::isSupported() {
+  return glCreateProgram && glCreateShader;
+}
+
+
+int ShaderProgram::getAttribute(const string &name) const {
+  int location = glGetAttribLocation(program, name.c_str());
+  if (location < 0) THROW("Program is missing attribute " << name);
+  return location;
+}
+
+
+int ShaderProgram::getUniform(const string &name) const {
+  int location = glGetUniformLocation(program, name.c_str());
+  if (location < 0) THROW("Program is missing uniform " << name);
+  return location;
+}
+
+
+void ShaderProgram::use() const {
+  glUseProgram(program);
+}
+
+
+void ShaderProgram::unuse() const {
+  glUseProgram(0);
+}
+
+
+void ShaderProgram::release() {
+  if (vertShader) glDeleteShader(vertShader);
+  if (fragShader) glDeleteShader(fragShader);
+  if (program) glDeleteProgram(program);
+  vertShader = fragShader = program = 0;
+}
+
+
+static const char *getSource(const string &filename) {
+  const Resource *data = FAH::Viewer::resource0.find(filename);
+  if (!data) THROW("Failed to find shader object: " << filename);
+  return (const char *)data->getData();
+}
+
+
+unsigned ShaderProgram::loadShader(const string &filename, unsigned type,
+                                   const string &library) {
+  // The library comes first so the shader can call its functions
+  const char *sources[2];
+  unsigned count = 0;
+  if (!library.empty()) sources[count++] = getSource(library);
+  sources[count++] = getSource(filename);
+
+  unsigned handle = glCreateShader(type);
+  glShaderSource(handle, count, sources, 0);
+  glCompileShader(handle);
+
+  int compileResult = 0;
+  glGetShaderiv(handle, GL_COMPILE_STATUS, &compileResult);
+  if (!compileResult) {
+    string log = getInfoLog(handle, false);
+    glDeleteShader(handle);
+    THROW("Failed to compile shader: " << filename << ": " << log);
+  }
+
+  glAttachShader(program, handle);
+
+  return handle;
+}
@@ -0,0 +1,64 @@
+/******************************************************************************\
+
+                       This file is part of the FAHViewer.
+
+            The FAHViewer displays 3D views of Folding@home proteins.
+                    Copyright (c) 2016-2020, foldingathome.org
+                   Copyright (c) 2003-2016, Stanford University
+                               All rights reserved.
+
+       This program is free software; you can redistribute it and/or modify
+       it under the terms of the GNU General Public License as published by
+        the Free Software Foundation; either version 2 of the License, or
+                       (at your option) any later version.
+
+         This program is distributed in the hope that it will be useful,
+          but WITHOUT ANY WARRANTY; without even the implied warranty of
+          MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+                   GNU General Public License for more details.
+
+     You should have received a copy of the GNU General Public License along
+     with this program; if not, write to the Free Software Foundation, Inc.,
+           51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+                  For information regarding this software email:
+                                 Joseph Coffland
+                          joseph@cauldrondevelopment.com
+
+\******************************************************************************/
+
+#pragma once
+
+#include <string>
+
+
+namespace FAH {
+  /// A GLSL program built from a vertex and a fragment shader resource.  A
+  /// library resource, such as the shared lighting, may be prepended to the
+  /// fragment shader.
+  class ShaderProgram {
+    unsigned program;
+    unsigned vertShader;
+    unsigned fragShader;
+
+  public:
+    ShaderProgram(const std::string &vertFile, const std::string &fragFile,
+                  const std::string &fragLibrary = std::string());
+    ~ShaderProgram();
+
+    /// @return true if the GL context supports GLSL programs
+    static bool isSupported();
+
+    unsigned getHandle() const {return program;}
+    int getAttribute(const std::string &name) const;
+    int getUniform(const std::string &name) const;
+
+    void use() const;
+    void unuse() const;
+
+  protected:
+    void release();
+    unsigned loadShader(const std::string &filename, unsigned type,
+                        const std::string &library = std::string());
+  };
+}
@@ -0,0 +1,103 @@
+/******************************************************************************\
+
+                       This file is part of the FAHViewer.
+
+            The FAHViewer displays 3D views of Folding@home proteins.
+                    Copyright (c) 2016-2020, foldingathome.org
+                   Copyright (c) 2003-2016, Stanford University
+                               All rights reserved.
+
+       This program is free software; you can redistribute it and/or modify
+       it under the terms of the GNU General Public License as published by
+        the Free Software Foundation; either version 2 of the License, or
+                       (at your option) any later version.
+
+         This program is distributed in the hope that it will be useful,
+          but WITHOUT ANY WARRANTY; without even the implied warranty of
+          MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+                   GNU General Public License for more details.
+
+     You should have received a copy of the GNU General Public License along
+     with this program; if not, write to the Free Software Foundation, Inc.,
+           51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+                  For information regarding this software email:
+                                 Joseph Coffland
+                          joseph@cauldrondevelopment.com
+
+\******************************************************************************/
+
+#include "SphereInstancer.h"
+#include "SphereVBO.h"
+
+#include <fah/viewer/GL.h>
+
+#include <cbang/Exception.h>
+
+using namespace std;
+using namespace cb;
+using namespace FAH;
+
+
+SphereInstancer::SphereInstancer() : buffer(0) {
+  if (!isSupported()) THROW("Instanced drawing not supported");
+
+  program = new ShaderProgram("sphereInstanced.vert", "sphereInstanced.frag",
+                              "shade.glsl");
+
+  positionAttrib = program->getAttribute("instancePosition");
+  diffuseAttrib = program->getAttribute("instanceDiffuse");
+  specularAttrib = program->getAttribute("instanceSpecular");
+
+  glGenBuffers(1, &buffer);
+
+  CHECK_GL_ERROR("");
+}
+
+
+SphereInstancer::~SphereInstancer() {
+  if (buffer) glDeleteBuffers(1, &buffer);
+}
+
+
+bool SphereInstancer::isSupported() {
+  return ShaderProgram::isSupported() && glGenBuffers &&
+    glVertexAttribDivisor && glDrawArraysInstanced;
+}
+
+
+void SphereInstancer::draw(SphereVBO &sphere,
+                           const vector<Instance> &instances) {
+  if (instances.empty()) return;
+
+  // Upload this frame's instance data
+  glBindBuffer(GL_ARRAY_BUFFER, buffer);
+  glBufferData(GL_ARRAY_BUFFER, instances.size() * sizeof(Instance),
+               &instances[0], GL_STREAM_DRAW);
+
+  const int attribs[] = {positionAttrib, diffuseAttrib, specularAttrib};
+  for (unsigned i = 0; i < 3; i++) {
+    glEnableVertexAttribArray(attribs[i]);
+    glVertexAttribPointer(attribs[i], 4, GL_FLOAT, GL_FALSE, sizeof(Instance),
+                          (void *)(i * 4 * sizeof(float)));
+    glVertexAttribDivisor(attribs[i], 1);
+  }
+
+  program->use();
+
+  sphere.bind();
+  sphere.drawInstanced(instances.size());
+  sphere.unbind();
+
+  program->unuse();
+
+  for (unsigned i = 0; i < 3; i++) {
+    glVertexAttribDivisor(attribs[i], 0);
+    glDisableVertexAttribArray(attribs[i]);
+  }
+
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+  CHECK_GL_ERROR("");
+}
+
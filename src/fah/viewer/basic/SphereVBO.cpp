@@ -100,3 +100,8 @@ SphereVBO::SphereVBO(const Vector3D &center, float radius, int slices,
 void SphereVBO::draw() {
   glDrawArrays(GL_QUAD_STRIP, 0, slices * slices);
 }
+
+
+void SphereVBO::drawInstanced(unsigned count) {
+  glDrawArraysInstanced(GL_QUAD_STRIP, 0, slices * slices, count);
+}
@@ -42,6 +42,9 @@ namespace FAH {
     SphereVBO(const cb::Vector3D &center, float radius, int slices,
               bool textured);
 
+    /// Draw @param count instances, requires GL 3.1 or later
+    void drawInstanced(unsigned count);
+
     // From VBO
     void draw();
   };
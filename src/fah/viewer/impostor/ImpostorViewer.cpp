@@ -0,0 +1,242 @@
+/******************************************************************************\
+
+                       This file is part of the FAHViewer.
+
+            The FAHViewer displays 3D views of Folding@home proteins.
+                    Copyright (c) 2016-2020, foldingathome.org
+                   Copyright (c) 2003-2016, Stanford University
+                               All rights reserved.
+
+       This program is free software; you can redistribute it and/or modify
+       it under the terms of the GNU General Public License as published by
+        the Free Software Foundation; either version 2 of the License, or
+                       (at your option) any later version.
+
+         This program is distributed in the hope that it will be useful,
+          but WITHOUT ANY WARRANTY; without even the implied warranty of
+          MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+                   GNU General Public License for more details.
+
+     You should have received a copy of the GNU General Public License along
+     with this program; if not, write to the Free Software Foundation, Inc.,
+           51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+                  For information regarding this software email:
+                                 Joseph Coffland
+                          joseph@cauldrondevelopment.com
+
+\******************************************************************************/
+
+
+#include "ImpostorViewer.h"
+
+#include <fah/viewer/GL.h>
+#include <fah/viewer/View.h>
+
+#include <cbang/Exception.h>
+#include <cbang/Catch.h>
+#include <cbang/log/Logger.h>
+
+using namespace std;
+using namespace cb;
+using namespace FAH;
+
+
+ImpostorViewer::ImpostorViewer() : quad(0), buffer(0) {}
+
+
+bool ImpostorViewer::isSupported() {
+  return ShaderProgram::isSupported() && glGenBuffers &&
+    glVertexAttribDivisor && glDrawArraysInstanced;
+}
+
+
+void ImpostorViewer::drawAtoms(const Protein &protein) {
+  if (sphereProgram.isNull()) {
+    BasicViewer::drawAtoms(protein);
+    return;
+  }
+
+  const Positions &positions = *protein.getPositions();
+  const Topology::atoms_t &atoms = protein.getTopology()->getAtoms();
+  double sphereSize = getSphereSize();
+
+  spheres.resize(atoms.size());
+  unsigned count = 0;
+
+  for (unsigned i = 0; i < atoms.size(); i++) {
+    if (!culler.isVisible(i)) continue;
+
+    SphereImpostor &sphere = spheres[count++];
+    const Vector3D p = getPosition(positions, i);
+
+    sphere.center[0] = p.x();
+    sphere.center[1] = p.y();
+    sphere.center[2] = p.z();
+    sphere.center[3] = sphereSize * getAtomScale(atoms[i]);
+
+    getMaterial(atoms[i], sphere.diffuse, sphere.specular);
+  }
+
+  spheres.resize(count);
+  if (spheres.empty()) return;
+
+  static const char *attribs[] = {
+    "impostorCenter", "impostorDiffuse", "impostorSpecular",
+  };
+
+  drawImpostors(*sphereProgram, attribs, 3, &spheres[0], spheres.size());
+}
+
+
+void ImpostorViewer::drawBonds(const Protein &protein) {
+  if (cylinderProgram.isNull()) {
+    BasicViewer::drawBonds(protein);
+    return;
+  }
+
+  if (isSpaceFilledMode()) return;
+
+  const Positions &positions = *protein.getPositions();
+  const Topology::atoms_t &atoms = protein.getTopology()->getAtoms();
+  const Topology::bonds_t &bonds = protein.getTopology()->getBonds();
+  bool stick = isStickMode();
+
+  // The ball and stick bond material, see BasicViewer::drawBond()
+  const float bondDiffuse[] = {0.4, 0.4, 0.0, 1.0};
+  const float bondSpecular[] = {0.25, 0.25, 0.25, 20};
+
+  cylinders.clear();
+  cylinders.reserve(bonds.size());
+
+  for (unsigned i = 0; i < bonds.size(); i++) {
+    const Bond &bond = bonds[i];
+    const Atom &leftAtom = atoms[bond.left];
+    const Atom &rightAtom = atoms[bond.right];
+    const Vector3D left = getPosition(positions, bond.left);
+    const Vector3D right = getPosition(positions, bond.right);
+
+    // Don't draw bonds which are too long
+    if (leftAtom.averageBondLength(rightAtom) * 2 < left.distance(right))
+      continue;
+
+    if (!culler.isVisible(left, right, BOND_RADIUS)) continue;
+
+    cylinders.push_back(CylinderImpostor());
+    CylinderImpostor &c = cylinders.back();
+
+    for (unsigned j = 0; j < 3; j++) {
+      c.left[j] = left[j];
+      c.right[j] = right[j];
+    }
+    c.left[3] = c.right[3] = BOND_RADIUS;
+
+    if (stick) {
+      getMaterial(leftAtom, c.leftDiffuse, c.leftSpecular);
+      getMaterial(rightAtom, c.rightDiffuse, c.rightSpecular);
+
+    } else
+      for (unsigned j = 0; j < 4; j++) {
+        c.leftDiffuse[j] = c.rightDiffuse[j] = bondDiffuse[j];
+        c.leftSpecular[j] = c.rightSpecular[j] = bondSpecular[j];
+      }
+  }
+
+  if (cylinders.empty()) return;
+
+  static const char *attribs[] = {
+    "impostorLeft", "impostorRight", "impostorLeftDiffuse",
+    "impostorRightDiffuse", "impostorLeftSpecular", "impostorRightSpecular",
+  };
+
+  drawImpostors(*cylinderProgram, attribs, 6, &cylinders[0],
+                cylinders.size());
+}
+
+
+void ImpostorViewer::init(ViewMode mode) {
+  BasicViewer::init(mode);
+
+  if (!isSupported()) {
+    LOG_WARNING("Impostor rendering not supported, using meshes");
+    return;
+  }
+
+  try {
+    sphereProgram =
+      new ShaderProgram("sphereImpostor.vert", "sphereImpostor.frag",
+                        "shade.glsl");
+    cylinderProgram =
+      new ShaderProgram("cylinderImpostor.vert", "cylinderImpostor.frag",
+                        "shade.glsl");
+
+    // Quad corners, expanded around each impostor in the vertex shader
+    const float corners[] = {-1, -1, 1, -1, -1, 1, 1, 1};
+
+    glGenBuffers(1, &quad);
+    glBindBuffer(GL_ARRAY_BUFFER, quad);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(corners), corners, GL_STATIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    glGenBuffers(1, &buffer);
+
+    CHECK_GL_ERROR("");
+    return;
+  } CATCH_WARNING;
+
+  LOG_WARNING("Impostor rendering failed, using meshes");
+  sphereProgram = cylinderProgram = 0;
+}
+
+
+void ImpostorViewer::release() {
+  if (!initialized) return;
+
+  sphereProgram = cylinderProgram = 0;
+  if (quad) glDeleteBuffers(1, &quad);
+  if (buffer) glDeleteBuffers(1, &buffer);
+  quad = buffer = 0;
+
+  BasicViewer::release();
+}
+
+
+void ImpostorViewer::drawImpostors(const ShaderProgram &program,
+                                   const char *attribs[], unsigned attribCount,
+                                   const void *data, unsigned count) {
+  unsigned stride = attribCount * 4 * sizeof(float);
+  vector<int> locations(attribCount);
+
+  // Quad corners
+  glBindBuffer(GL_ARRAY_BUFFER, quad);
+  glVertexPointer(2, GL_FLOAT, 0, 0);
+  glEnableClientState(GL_VERTEX_ARRAY);
+
+  // Per impostor data, uploaded every frame
+  glBindBuffer(GL_ARRAY_BUFFER, buffer);
+  glBufferData(GL_ARRAY_BUFFER, count * stride, data, GL_STREAM_DRAW);
+
+  for (unsigned i = 0; i < attribCount; i++) {
+    locations[i] = program.getAttribute(attribs[i]);
+    glEnableVertexAttribArray(locations[i]);
+    glVertexAttribPointer(locations[i], 4, GL_FLOAT, GL_FALSE, stride,
+                          (void *)(i * 4 * sizeof(float)));
+    glVertexAttribDivisor(locations[i], 1);
+  }
+
+  glDisable(GL_CULL_FACE);
+  program.use();
+  glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, count);
+  program.unuse();
+  glEnable(GL_CULL_FACE);
+
+  for (unsigned i = 0; i < attribCount; i++) {
+    glVertexAttribDivisor(locations[i], 0);
+    glDisableVertexAttribArray(locations[i]);
+  }
+
+  glDisableClientState(GL_VERTEX_ARRAY);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+  CHECK_GL_ERROR("");
+}
@@ -0,0 +1,90 @@
+/******************************************************************************\
+
+                       This file is part of the FAHViewer.
+
+            The FAHViewer displays 3D views of Folding@home proteins.
+                    Copyright (c) 2016-2020, foldingathome.org
+                   Copyright (c) 2003-2016, Stanford University
+                               All rights reserved.
+
+       This program is free software; you can redistribute it and/or modify
+       it under the terms of the GNU General Public License as published by
+        the Free Software Foundation; either version 2 of the License, or
+                       (at your option) any later version.
+
+         This program is distributed in the hope that it will be useful,
+          but WITHOUT ANY WARRANTY; without even the implied warranty of
+          MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+                   GNU General Public License for more details.
+
+     You should have received a copy of the GNU General Public License along
+     with this program; if not, write to the Free Software Foundation, Inc.,
+           51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+                  For information regarding this software email:
+                                 Joseph Coffland
+                          joseph@cauldrondevelopment.com
+
+\******************************************************************************/
+
+
+#pragma once
+
+#include <fah/viewer/basic/BasicViewer.h>
+#include <fah/viewer/basic/ShaderProgram.h>
+
+#include <cbang/SmartPointer.h>
+
+#include <vector>
+
+
+namespace FAH {
+  /// Draws atoms and bonds as screen aligned quads which are ray-cast per
+  /// fragment against the exact sphere or cylinder, writing correct depth.
+  /// Each atom or bond costs four vertices regardless of the tessellation
+  /// used by the other modes.
+  class ImpostorViewer : public BasicViewer {
+    struct SphereImpostor {
+      float center[4];   ///< xyz center, w radius
+      float diffuse[4];
+      float specular[4]; ///< rgb specular, a shininess
+    };
+
+    struct CylinderImpostor {
+      float left[4];          ///< xyz end point, w radius
+      float right[4];
+      float leftDiffuse[4];
+      float rightDiffuse[4];
+      float leftSpecular[4];  ///< rgb specular, a shininess
+      float rightSpecular[4];
+    };
+
+    cb::SmartPointer<ShaderProgram> sphereProgram;
+    cb::SmartPointer<ShaderProgram> cylinderProgram;
+
+    unsigned quad;
+    unsigned buffer;
+
+    std::vector<SphereImpostor> spheres;
+    std::vector<CylinderImpostor> cylinders;
+
+  public:
+    ImpostorViewer();
+    ~ImpostorViewer() {release();}
+
+    /// @return true if the GL context supports impostor rendering
+    static bool isSupported();
+
+    // From BasicViewer
+    void drawAtoms(const Protein &protein);
+    void drawBonds(const Protein &protein);
+
+    void init(ViewMode mode);
+    void release();
+
+  protected:
+    void drawImpostors(const ShaderProgram &program, const char *attribs[],
+                       unsigned attribCount, const void *data,
+                       unsigned count);
+  };
+}
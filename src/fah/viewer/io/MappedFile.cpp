@@ -0,0 +1,115 @@
+/******************************************************************************\
+
+                       This file is part of the FAHViewer.
+
+            The FAHViewer displays 3D views of Folding@home proteins.
+                    Copyright (c) 2016-2020, foldingathome.org
+                   Copyright (c) 2003-2016, Stanford University
+                               All rights reserved.
+
+       This program is free software; you can redistribute it and/or modify
+       it under the terms of the GNU General Public License as published by
+        the Free Software Foundation; either version 2 of the License, or
+                       (at your option) any later version.
+
+         This program is distributed in the hope that it will be useful,
+          but WITHOUT ANY WARRANTY; without even the implied warranty of
+          MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+                   GNU General Public License for more details.
+
+     You should have received a copy of the GNU General Public License along
+     with this program; if not, write to the Free Software Foundation, Inc.,
+           51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+                  For information regarding this software email:
+                                 Joseph Coffland
+                          joseph@cauldrondevelopment.com
+
+\******************************************************************************/
+
+
+#include "MappedFile.h"
+
+#include <cbang/Exception.h>
+
+#include <cstring>
+#include <cerrno>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+using namespace cb;
+using namespace FAH;
+
+
+MappedFile::MappedFile(const string &filename) :
+  filename(filename), data(0), length(0) {
+#ifdef _WIN32
+  file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, 0,
+                     OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0);
+  if (file == INVALID_HANDLE_VALUE) THROW("Failed to open " << filename);
+
+  LARGE_INTEGER size;
+  if (!GetFileSizeEx((HANDLE)file, &size)) {
+    CloseHandle((HANDLE)file);
+    THROW("Failed to get the size of " << filename);
+  }
+  length = size.QuadPart;
+
+  // Empty files cannot be mapped
+  mapping = 0;
+  if (!length) {data = ""; return;}
+
+  mapping = CreateFileMappingA((HANDLE)file, 0, PAGE_READONLY, 0, 0, 0);
+  if (mapping) data = (const char *)MapViewOfFile(mapping, FILE_MAP_READ,
+                                                  0, 0, 0);
+
+  if (!data) {
+    if (mapping) CloseHandle((HANDLE)mapping);
+    CloseHandle((HANDLE)file);
+    THROW("Failed to map " << filename);
+  }
+
+#else
+  fd = ::open(filename.c_str(), O_RDONLY);
+  if (fd == -1) THROW("Failed to open " << filename << ": " << strerror(errno));
+
+  struct stat st;
+  if (fstat(fd, &st)) {
+    ::close(fd);
+    THROW("Failed to stat " << filename << ": " << strerror(errno));
+  }
+  length = st.st_size;
+
+  // Empty files cannot be mapped
+  if (!length) {data = ""; return;}
+
+  void *ptr = mmap(0, length, PROT_READ, MAP_PRIVATE, fd, 0);
+  if (ptr == MAP_FAILED) {
+    ::close(fd);
+    THROW("Failed to map " << filename << ": " << strerror(errno));
+  }
+
+  data = (const char *)ptr;
+#endif
+}
+
+
+MappedFile::~MappedFile() {
+#ifdef _WIN32
+  if (length) UnmapViewOfFile(data);
+  if (mapping) CloseHandle((HANDLE)mapping);
+  CloseHandle((HANDLE)file);
+
+#else
+  if (length) munmap((void *)data, length);
+  ::close(fd);
+#endif
+}
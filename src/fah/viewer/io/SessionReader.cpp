@@ -0,0 +1,77 @@
+/******************************************************************************\
+
+                       This file is part of the FAHViewer.
+
+            The FAHViewer displays 3D views of Folding@home proteins.
+                    Copyright (c) 2016-2020, foldingathome.org
+                   Copyright (c) 2003-2016, Stanford University
+                               All rights reserved.
+
+       This program is free software; you can redistribute it and/or modify
+       it under the terms of the GNU General Public License as published by
+        the Free Software Foundation; either version 2 of the License, or
+                       (at your option) any later version.
+
+         This program is distributed in the hope that it will be useful,
+          but WITHOUT ANY WARRANTY; without even the implied warranty of
+          MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+                   GNU General Public License for more details.
+
+     You should have received a copy of the GNU General Public License along
+     with this program; if not, write to the Free Software Foundation, Inc.,
+           51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+                  For information regarding this software email:
+                                 Joseph Coffland
+                          joseph@cauldrondevelopment.com
+
+\******************************************************************************/
+
+
+#include "SessionReader.h"
+#include "SessionWriter.h"
+
+#include <cbang/Exception.h>
+
+#include <cstring>
+
+using namespace std;
+using namespace cb;
+using namespace FAH;
+
+
+namespace {
+  bool readLE(istream &stream, uint64_t &value, unsigned bytes) {
+    unsigned char buf[8];
+    if (!stream.read((char *)buf, bytes)) return false;
+
+    value = 0;
+    for (unsigned i = 0; i < bytes; i++) value |= (uint64_t)buf[i] << (8 * i);
+
+    return true;
+  }
+}
+
+
+SessionReader::SessionReader(const InputSource &source) : source(source) {
+  char magic[8];
+  if (!source.getStream().read(magic, 8) ||
+      strncmp(magic, FAH_SESSION_MAGIC, 8))
+    THROW("'" << source.getName() << "' is not a session capture");
+}
+
+
+bool SessionReader::read(double &time, string &data) {
+  istream &stream = source.getStream();
+  uint64_t usec, length;
+
+  if (!readLE(stream, usec, 8)) return false;
+  if (!readLE(stream, length, 4)) THROW("Truncated session record");
+
+  data.resize(length);
+  if (length && !stream.read(&data[0], length))
+    THROW("Truncated session record");
+
+  time = usec / 1e6;
+  return true;
+}
@@ -0,0 +1,62 @@
+/******************************************************************************\
+
+                       This file is part of the FAHViewer.
+
+            The FAHViewer displays 3D views of Folding@home proteins.
+                    Copyright (c) 2016-2020, foldingathome.org
+                   Copyright (c) 2003-2016, Stanford University
+                               All rights reserved.
+
+       This program is free software; you can redistribute it and/or modify
+       it under the terms of the GNU General Public License as published by
+        the Free Software Foundation; either version 2 of the License, or
+                       (at your option) any later version.
+
+         This program is distributed in the hope that it will be useful,
+          but WITHOUT ANY WARRANTY; without even the implied warranty of
+          MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+                   GNU General Public License for more details.
+
+     You should have received a copy of the GNU General Public License along
+     with this program; if not, write to the Free Software Foundation, Inc.,
+           51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+                  For information regarding this software email:
+                                 Joseph Coffland
+                          joseph@cauldrondevelopment.com
+
+\******************************************************************************/
+
+
+#include "SessionWriter.h"
+
+#include <cbang/time/Timer.h>
+
+using namespace std;
+using namespace cb;
+using namespace FAH;
+
+
+namespace {
+  void writeLE(ostream &stream, uint64_t value, unsigned bytes) {
+    char buf[8];
+    for (unsigned i = 0; i < bytes; i++) buf[i] = (char)(value >> (8 * i));
+    stream.write(buf, bytes);
+  }
+}
+
+
+SessionWriter::SessionWriter(const OutputSink &sink) :
+  sink(sink), start(Timer::now()) {
+  sink.getStream().write(FAH_SESSION_MAGIC, 8);
+}
+
+
+void SessionWriter::write(const char *data, uint32_t length) {
+  ostream &stream = sink.getStream();
+
+  writeLE(stream, (uint64_t)((Timer::now() - start) * 1e6), 8);
+  writeLE(stream, length, 4);
+  stream.write(data, length);
+  stream.flush(); // Keep the capture usable if the viewer is killed
+}
@@ -0,0 +1,54 @@
+/******************************************************************************\
+
+                       This file is part of the FAHViewer.
+
+            The FAHViewer displays 3D views of Folding@home proteins.
+                    Copyright (c) 2016-2020, foldingathome.org
+                   Copyright (c) 2003-2016, Stanford University
+                               All rights reserved.
+
+       This program is free software; you can redistribute it and/or modify
+       it under the terms of the GNU General Public License as published by
+        the Free Software Foundation; either version 2 of the License, or
+                       (at your option) any later version.
+
+         This program is distributed in the hope that it will be useful,
+          but WITHOUT ANY WARRANTY; without even the implied warranty of
+          MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+                   GNU General Public License for more details.
+
+     You should have received a copy of the GNU General Public License along
+     with this program; if not, write to the Free Software Foundation, Inc.,
+           51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+                  For information regarding this software email:
+                                 Joseph Coffland
+                          joseph@cauldrondevelopment.com
+
+\******************************************************************************/
+
+
+#pragma once
+
+#include <cbang/io/OutputSink.h>
+
+#include <cstdint>
+
+#define FAH_SESSION_MAGIC "FAHSESS1"
+
+
+namespace FAH {
+  /// Records the raw bytes received from a client for later replay.  The
+  /// file starts with FAH_SESSION_MAGIC followed by one record per read,
+  /// each a little-endian uint64 microsecond offset from the start of the
+  /// capture, a uint32 length and the data.
+  class SessionWriter {
+    const cb::OutputSink sink;
+    double start;
+
+  public:
+    SessionWriter(const cb::OutputSink &sink);
+
+    void write(const char *data, uint32_t length);
+  };
+}
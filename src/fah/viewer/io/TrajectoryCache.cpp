@@ -0,0 +1,247 @@
+/******************************************************************************\
+
+                       This file is part of the FAHViewer.
+
+            The FAHViewer displays 3D views of Folding@home proteins.
+                    Copyright (c) 2016-2020, foldingathome.org
+                   Copyright (c) 2003-2016, Stanford University
+                               All rights reserved.
+
+       This program is free software; you can redistribute it and/or modify
+       it under the terms of the GNU General Public License as published by
+        the Free Software Foundation; either version 2 of the License, or
+                       (at your option) any later version.
+
+         This program is distributed in the hope that it will be useful,
+          but WITHOUT ANY WARRANTY; without even the implied warranty of
+          MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+                   GNU General Public License for more details.
+
+     You should have received a copy of the GNU General Public License along
+     with this program; if not, write to the Free Software Foundation, Inc.,
+           51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+                  For information regarding this software email:
+                                 Joseph Coffland
+                          joseph@cauldrondevelopment.com
+
+\******************************************************************************/
+
+
+#include "TrajectoryCache.h"
+
+#include <fah/viewer/Trajectory.h>
+
+#include <cbang/Exception.h>
+#include <cbang/log/Logger.h>
+
+#include <cstring>
+
+using namespace std;
+using namespace cb;
+using namespace FAH;
+
+
+// The records are written and mapped as is
+static_assert(sizeof(TrajectoryCache::Header) == 48, "Header layout");
+static_assert(sizeof(TrajectoryCache::AtomRecord) == 24, "Atom layout");
+static_assert(sizeof(TrajectoryCache::FrameRecord) == 64, "Frame layout");
+
+
+namespace {
+  uint64_t align64(uint64_t offset) {return (offset + 63) & ~(uint64_t)63;}
+
+
+  void pad(ostream &stream, uint64_t &offset, uint64_t target) {
+    static const char zeros[64] = {0};
+    stream.write(zeros, target - offset);
+    offset = target;
+  }
+
+
+  uint64_t getFrameBytes(unsigned atoms) {return align64(3 * 4 * atoms);}
+}
+
+
+TrajectoryCache::TrajectoryCache(const string &filename) : file(filename) {
+  validate();
+
+  const char *data = file.getData();
+  header = (const Header *)data;
+  atoms = (const AtomRecord *)(data + header->atomsOffset);
+  bonds = (const uint32_t *)(data + header->bondsOffset);
+  frames = (const FrameRecord *)(data + header->framesOffset);
+
+  LOG_INFO(1, "Mapped trajectory cache '" << filename << "' with "
+           << header->atoms << " atoms and " << header->frames << " frames");
+}
+
+
+void TrajectoryCache::readTopology(Topology &topology) const {
+  topology.clear();
+
+  for (unsigned i = 0; i < header->atoms; i++) {
+    const AtomRecord &r = atoms[i];
+    Atom atom;
+    atom.load(string(r.type, strnlen(r.type, sizeof(r.type))), r.charge,
+              r.radius, r.mass, r.number);
+    topology.add(atom);
+  }
+
+  for (unsigned i = 0; i < header->bonds; i++)
+    topology.add(Bond(bonds[2 * i], bonds[2 * i + 1]));
+
+  topology.setTS();
+}
+
+
+void TrajectoryCache::readFrame(unsigned frame, Positions &positions) const {
+  if (header->frames <= frame) THROW("Invalid frame " << frame);
+
+  const FrameRecord &r = frames[frame];
+  const float *coords = (const float *)(file.getData() + r.offset);
+  unsigned n = header->atoms;
+
+  // Pages are faulted in from the file by the copy
+  positions.resize(n);
+  memcpy(positions.getX(), coords, n * sizeof(float));
+  memcpy(positions.getY(), coords + n, n * sizeof(float));
+  memcpy(positions.getZ(), coords + 2 * n, n * sizeof(float));
+
+  vector<Vector3D> box;
+  for (unsigned i = 0; i < r.boxSize; i++)
+    box.push_back(Vector3D(r.box[i][0], r.box[i][1], r.box[i][2]));
+  positions.setBox(box);
+  positions.setOffset(Vector3D(r.boxOffset[0], r.boxOffset[1],
+                               r.boxOffset[2]));
+
+  positions.init();
+}
+
+
+void TrajectoryCache::write(const OutputSink &sink, Trajectory &trajectory) {
+  const Topology &topology = *trajectory.getTopology();
+  const Topology::atoms_t &atoms = topology.getAtoms();
+  const Topology::bonds_t &bonds = topology.getBonds();
+  unsigned frames = trajectory.getKeyframeCount();
+
+  if (!frames) THROW("Cannot write an empty trajectory");
+  unsigned n = trajectory.getKeyframe(0)->size();
+  if (atoms.size() != n)
+    THROW("Topology with " << atoms.size() << " atoms does not match "
+          << n << " positions");
+
+  Header header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, FAH_TRAJECTORY_CACHE_MAGIC, 8);
+  header.version = FAH_TRAJECTORY_CACHE_VERSION;
+  header.atoms = n;
+  header.bonds = bonds.size();
+  header.frames = frames;
+  header.atomsOffset = align64(sizeof(Header));
+  header.bondsOffset = align64(header.atomsOffset + n * sizeof(AtomRecord));
+  header.framesOffset =
+    align64(header.bondsOffset + bonds.size() * 2 * sizeof(uint32_t));
+  uint64_t dataOffset =
+    align64(header.framesOffset + frames * sizeof(FrameRecord));
+
+  ostream &stream = sink.getStream();
+  uint64_t offset = sizeof(Header);
+  stream.write((const char *)&header, sizeof(Header));
+
+  // Atoms
+  pad(stream, offset, header.atomsOffset);
+  for (unsigned i = 0; i < n; i++) {
+    AtomRecord r;
+    memset(&r, 0, sizeof(r));
+    strncpy(r.type, atoms[i].getType().c_str(), sizeof(r.type));
+    r.charge = atoms[i].getCharge();
+    r.radius = atoms[i].getRadius();
+    r.mass = atoms[i].getMass();
+    r.number = atoms[i].getNumber();
+
+    stream.write((const char *)&r, sizeof(r));
+    offset += sizeof(r);
+  }
+
+  // Bonds
+  pad(stream, offset, header.bondsOffset);
+  for (unsigned i = 0; i < bonds.size(); i++) {
+    uint32_t pair[2] = {bonds[i].left, bonds[i].right};
+    stream.write((const char *)pair, sizeof(pair));
+    offset += sizeof(pair);
+  }
+
+  // Frame index
+  pad(stream, offset, header.framesOffset);
+  for (unsigned i = 0; i < frames; i++) {
+    const Positions &p = *trajectory.getKeyframe(i);
+    if (p.size() != n) THROW("Frame " << i << " has " << p.size()
+                             << " positions, expected " << n);
+
+    FrameRecord r;
+    memset(&r, 0, sizeof(r));
+    r.offset = dataOffset + i * getFrameBytes(n);
+    r.radius = p.getRadius();
+
+    const vector<Vector3D> &box = p.getBox();
+    r.boxSize = box.size() <= 3 ? box.size() : 0;
+    for (unsigned j = 0; j < r.boxSize; j++)
+      for (unsigned k = 0; k < 3; k++) r.box[j][k] = box[j][k];
+    for (unsigned k = 0; k < 3; k++) r.boxOffset[k] = p.getOffset()[k];
+
+    stream.write((const char *)&r, sizeof(r));
+    offset += sizeof(r);
+  }
+
+  // Coordinates
+  for (unsigned i = 0; i < frames; i++) {
+    pad(stream, offset, dataOffset + i * getFrameBytes(n));
+
+    const Positions &p = *trajectory.getKeyframe(i);
+    stream.write((const char *)p.getX(), n * sizeof(float));
+    stream.write((const char *)p.getY(), n * sizeof(float));
+    stream.write((const char *)p.getZ(), n * sizeof(float));
+    offset += 3 * n * sizeof(float);
+  }
+
+  pad(stream, offset, align64(offset));
+  stream.flush();
+
+  if (!stream) THROW("Failed to write trajectory cache " << sink.getName());
+
+  LOG_INFO(1, "Wrote trajectory cache '" << sink.getName() << "' with "
+           << n << " atoms and " << frames << " frames");
+}
+
+
+void TrajectoryCache::validate() const {
+  const string &filename = file.getFilename();
+  const char *data = file.getData();
+  uint64_t length = file.getLength();
+
+  if (length < sizeof(Header)) THROW(filename << " is too short");
+
+  const Header &h = *(const Header *)data;
+  if (strncmp(h.magic, FAH_TRAJECTORY_CACHE_MAGIC, 8))
+    THROW(filename << " is not a trajectory cache");
+  if (h.version != FAH_TRAJECTORY_CACHE_VERSION)
+    THROW(filename << " has unsupported version " << h.version);
+
+  if (length < h.atomsOffset + (uint64_t)h.atoms * sizeof(AtomRecord) ||
+      length < h.bondsOffset + (uint64_t)h.bonds * 2 * sizeof(uint32_t) ||
+      length < h.framesOffset + (uint64_t)h.frames * sizeof(FrameRecord))
+    THROW(filename << " is truncated");
+
+  const FrameRecord *f = (const FrameRecord *)(data + h.framesOffset);
+  uint64_t frameBytes = 3 * sizeof(float) * (uint64_t)h.atoms;
+
+  for (unsigned i = 0; i < h.frames; i++)
+    if (length < f[i].offset + frameBytes || f[i].offset % 4 ||
+        3 < f[i].boxSize)
+      THROW(filename << " frame " << i << " is invalid");
+
+  const uint32_t *b = (const uint32_t *)(data + h.bondsOffset);
+  for (unsigned i = 0; i < 2 * h.bonds; i++)
+    if (h.atoms <= b[i]) THROW(filename << " has an invalid bond");
+}
@@ -0,0 +1,113 @@
+/******************************************************************************\
+
+                       This file is part of the FAHViewer.
+
+            The FAHViewer displays 3D views of Folding@home proteins.
+                    Copyright (c) 2016-2020, foldingathome.org
+                   Copyright (c) 2003-2016, Stanford University
+                               All rights reserved.
+
+       This program is free software; you can redistribute it and/or modify
+       it under the terms of the GNU General Public License as published by
+        the Free Software Foundation; either version 2 of the License, or
+                       (at your option) any later version.
+
+         This program is distributed in the hope that it will be useful,
+          but WITHOUT ANY WARRANTY; without even the implied warranty of
+          MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+                   GNU General Public License for more details.
+
+     You should have received a copy of the GNU General Public License along
+     with this program; if not, write to the Free Software Foundation, Inc.,
+           51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+                  For information regarding this software email:
+                                 Joseph Coffland
+                          joseph@cauldrondevelopment.com
+
+\******************************************************************************/
+
+
+#pragma once
+
+#include "MappedFile.h"
+
+#include <cbang/io/OutputSink.h>
+
+#include <string>
+#include <cstdint>
+
+#define FAH_TRAJECTORY_CACHE_MAGIC "FAHVTRJ1"
+#define FAH_TRAJECTORY_CACHE_VERSION 1
+
+
+namespace FAH {
+  class Topology;
+  class Positions;
+  class Trajectory;
+
+  /// A memory mapped binary trajectory file.  It holds the topology and the
+  /// keyframes exactly as Trajectory keeps them, after centering and
+  /// alignment, so frames can be paged in on demand with a copy.
+  ///
+  /// Layout, little-endian, with every section 64 byte aligned:
+  ///
+  ///   Header
+  ///   AtomRecord[atoms]
+  ///   uint32_t bonds[bonds][2]
+  ///   FrameRecord[frames]
+  ///   float x[atoms], y[atoms], z[atoms] for each frame
+  class TrajectoryCache {
+  public:
+    struct Header {
+      char magic[8];
+      uint32_t version;
+      uint32_t atoms;
+      uint32_t bonds;
+      uint32_t frames;
+      uint64_t atomsOffset;
+      uint64_t bondsOffset;
+      uint64_t framesOffset;
+    };
+
+    struct AtomRecord {
+      char type[8];
+      float charge;
+      float radius;
+      float mass;
+      uint32_t number;
+    };
+
+    struct FrameRecord {
+      uint64_t offset;
+      float radius;
+      uint32_t boxSize;
+      float box[3][3];
+      float boxOffset[3];
+    };
+
+  protected:
+    MappedFile file;
+
+    const Header *header;
+    const AtomRecord *atoms;
+    const uint32_t *bonds;
+    const FrameRecord *frames;
+
+  public:
+    TrajectoryCache(const std::string &filename);
+
+    const std::string &getFilename() const {return file.getFilename();}
+    unsigned getAtomCount() const {return header->atoms;}
+    unsigned getFrameCount() const {return header->frames;}
+    double getRadius(unsigned frame) const {return frames[frame].radius;}
+
+    void readTopology(Topology &topology) const;
+    void readFrame(unsigned frame, Positions &positions) const;
+
+    static void write(const cb::OutputSink &sink, Trajectory &trajectory);
+
+  protected:
+    void validate() const;
+  };
+}
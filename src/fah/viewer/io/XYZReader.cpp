@@ -27,67 +27,207 @@
 
 \******************************************************************************/
 
+
 #include "XYZReader.h"
 
 #include <fah/viewer/Positions.h>
 #include <fah/viewer/Topology.h>
 
 #include <cbang/Exception.h>
-#include <cbang/String.h>
+#include <cbang/util/Resource.h>
 
-#include <vector>
-#include <string>
+#include <charconv>
+#include <cstring>
+#include <cstdlib>
 
 using namespace std;
 using namespace cb;
 using namespace FAH;
 
 
-void XYZReader::read(Positions &positions, Topology *topology) {
-  istream &stream = source.getStream();
-  vector<string> tokens;
-  char line[1024];
+namespace {
+  bool isSpace(char c) {return c == ' ' || c == '\t' || c == '\r';}
+  bool isDigit(char c) {return '0' <= c && c <= '9';}
+}
+
 
-  // Read header line
-  stream.getline(line, 1024);
-  if (stream.fail()) THROW("Failed to read XYZ");
+XYZReader::XYZReader(const string &filename) : file(new MappedFile(filename)),
+  ptr(file->getData()), end(file->getEnd()) {}
 
-  // Get atom count
-  String::tokenize(line, tokens);
-  if (tokens.size() < 1) THROW("Missing atom count in XYZ");
 
-  unsigned count = String::parseU32(tokens[0]);
-  unsigned lineNum = 1;
+XYZReader::XYZReader(const Resource &resource) :
+  ptr(resource.getData()), end(resource.getData() + resource.getLength()) {}
+
+
+uint64_t XYZReader::getLength() const {
+  return file.isNull() ? 0 : file->getLength();
+}
+
+
+uint64_t XYZReader::getOffset() const {
+  return file.isNull() ? 0 : ptr - file->getData();
+}
+
+
+bool XYZReader::read(Positions &positions, Topology *topology) {
+  // Header line, skipping blank lines between frames
+  const char *line;
+  const char *eol;
+  const char *token;
+
+  do {
+    if (ptr == end) return false;
+    line = ptr;
+    eol = nextLine();
+  } while (!nextToken(token = line, eol));
+
+  // Get atom count
+  const char *tokenEnd = nextToken(token, eol);
+  if (!isDigit(*token)) THROW("Missing atom count in XYZ at line " << lineNum);
+  unsigned count = parseUnsigned(token, tokenEnd);
 
   // Reset
-  positions.clear();
+  positions.resize(count);
+  float *x = positions.getX();
+  float *y = positions.getY();
+  float *z = positions.getZ();
   if (topology) topology->clear();
 
   // Read atoms and positions
-  while (!stream.fail() && count) {
-    stream.getline(line, 1024);
-    lineNum++;
-
-    tokens.clear();
-    String::tokenize(line, tokens);
+  unsigned i = 0;
+  while (ptr != end && i < count) {
+    line = ptr;
+    eol = nextLine();
+
+    const char *fields[5][2];
+    unsigned n = 0;
+    for (token = line; n < 5; n++) {
+      if (!(fields[n][1] = nextToken(token, eol))) break;
+      fields[n][0] = token;
+      token = fields[n][1];
+    }
 
-    if (tokens.size() < 1 || !isdigit(tokens[0][0])) continue;
-    if (tokens.size() < 5) THROW("Invalid XYZ file at line: " << lineNum);
+    if (n < 1 || !isDigit(*fields[0][0])) continue;
+    if (n < 5) THROW("Invalid XYZ file at line: " << lineNum);
 
     if (topology) {
-      Atom atom(tokens[1]);
-      atom.setIndex(String::parseU32(tokens[0]));
+      Atom atom = getAtom(fields[1][0], fields[1][1]);
+      atom.setIndex(parseUnsigned(fields[0][0], fields[0][1]));
       topology->add(atom);
     }
 
-    positions.push_back(Vector3D(String::parseDouble(tokens[2]),
-                                 String::parseDouble(tokens[3]),
-                                 String::parseDouble(tokens[4])));
-
-    count--;
+    x[i] = parseDouble(fields[2][0], fields[2][1]);
+    y[i] = parseDouble(fields[3][0], fields[3][1]);
+    z[i] = parseDouble(fields[4][0], fields[4][1]);
+    i++;
   }
 
+  if (i < count)
+    THROW("Failed reading XYZ, expected " << (count - i) << " more atoms");
+
   positions.init();
 
-  if (count) THROW("Failed reading XYZ, expected " << count << " more atoms");
+  return true;
+}
+
+
+const char *XYZReader::nextLine() {
+  const char *eol = (const char *)memchr(ptr, '\n', end - ptr);
+
+  if (eol) ptr = eol + 1;
+  else ptr = eol = end;
+
+  lineNum++;
+
+  return eol;
+}
+
+
+const char *XYZReader::nextToken(const char *&token, const char *eol) {
+  while (token < eol && isSpace(*token)) token++;
+  if (token == eol) return 0;
+
+  const char *tokenEnd = token;
+  while (tokenEnd < eol && !isSpace(*tokenEnd)) tokenEnd++;
+
+  return tokenEnd;
+}
+
+
+const Atom &XYZReader::getAtom(const char *type, const char *typeEnd) {
+  // Element lookup by name is slow and there are only a few distinct names
+  string name(type, typeEnd);
+
+  auto it = atoms.find(name);
+  if (it == atoms.end()) it = atoms.insert(make_pair(name, Atom(name))).first;
+
+  return it->second;
+}
+
+
+double XYZReader::parseDouble(const char *start, const char *end) const {
+  // Fast path for plain decimals with up to 15 digits.  One division of two
+  // exactly representable values is correctly rounded.
+  static const double pow10[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12,
+    1e13, 1e14, 1e15};
+
+  const char *p = start;
+  bool negative = p < end && *p == '-';
+  if (p < end && (*p == '-' || *p == '+')) p++;
+
+  uint64_t mantissa = 0;
+  unsigned digits = 0;
+  unsigned fraction = 0;
+  bool point = false;
+
+  for (; p < end && digits <= 15; p++)
+    if (isDigit(*p)) {
+      mantissa = mantissa * 10 + (*p - '0');
+      digits++;
+      if (point) fraction++;
+
+    } else if (*p == '.' && !point) point = true;
+    else break;
+
+  if (p == end && digits && digits <= 15) {
+    double value = mantissa / pow10[fraction];
+    return negative ? -value : value;
+  }
+
+  if (start < end && *start == '+') start++;
+
+#if defined(__cpp_lib_to_chars) && 201611L <= __cpp_lib_to_chars
+  double value;
+  from_chars_result result = from_chars(start, end, value);
+  if (result.ec != errc() || result.ptr != end)
+    THROW("Invalid number in XYZ at line " << lineNum);
+
+#else
+  // Without floating point from_chars() copy the token so strtod() cannot
+  // read past it
+  char buffer[64];
+  unsigned length = end - start;
+  if (sizeof(buffer) <= length)
+    THROW("Invalid number in XYZ at line " << lineNum);
+  memcpy(buffer, start, length);
+  buffer[length] = 0;
+
+  char *numberEnd;
+  double value = strtod(buffer, &numberEnd);
+  if (numberEnd != buffer + length)
+    THROW("Invalid number in XYZ at line " << lineNum);
+#endif
+
+  return value;
+}
+
+
+unsigned XYZReader::parseUnsigned(const char *start, const char *end) const {
+  unsigned value;
+  from_chars_result result = from_chars(start, end, value);
+  if (result.ec != errc() || result.ptr != end)
+    THROW("Invalid integer in XYZ at line " << lineNum);
+
+  return value;
 }
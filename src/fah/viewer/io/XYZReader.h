@@ -27,21 +27,53 @@
 
 \******************************************************************************/
 
+
 #pragma once
 
-#include <cbang/io/InputSource.h>
+#include "MappedFile.h"
+
+#include <fah/viewer/Atom.h>
+
+#include <cbang/SmartPointer.h>
+
+#include <string>
+#include <map>
+
+
+namespace cb {class Resource;}
 
 
 namespace FAH {
   class Positions;
   class Topology;
 
+  /// Parses Tinker style XYZ files in place, either memory mapped from disk
+  /// or straight out of a resource.  A file may hold several frames one
+  /// after the other.
   class XYZReader {
-    const cb::InputSource source;
+    cb::SmartPointer<MappedFile> file;
+    const char *ptr;
+    const char *end;
+    unsigned lineNum = 0;
+
+    /// Atoms already built from their type name
+    std::map<std::string, Atom> atoms;
 
   public:
-    XYZReader(const cb::InputSource &source) : source(source) {}
+    XYZReader(const std::string &filename);
+    XYZReader(const cb::Resource &resource);
+
+    uint64_t getLength() const;
+    uint64_t getOffset() const;
+
+    /// Reads the next frame.  @return false if there are no more frames.
+    bool read(Positions &positions, Topology *topology = 0);
 
-    void read(Positions &positions, Topology *topology = 0);
+  protected:
+    const char *nextLine();
+    const char *nextToken(const char *&token, const char *eol);
+    const Atom &getAtom(const char *type, const char *typeEnd);
+    double parseDouble(const char *start, const char *end) const;
+    unsigned parseUnsigned(const char *start, const char *end) const;
   };
 }
@@ -0,0 +1,262 @@
+/******************************************************************************\
+
+                       This file is part of the FAHViewer.
+
+            The FAHViewer displays 3D views of Folding@home proteins.
+                    Copyright (c) 2016-2020, foldingathome.org
+                   Copyright (c) 2003-2016, Stanford University
+                               All rights reserved.
+
+       This program is free software; you can redistribute it and/or modify
+       it under the terms of the GNU General Public License as published by
+        the Free Software Foundation; either version 2 of the License, or
+                       (at your option) any later version.
+
+         This program is distributed in the hope that it will be useful,
+          but WITHOUT ANY WARRANTY; without even the implied warranty of
+          MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+                   GNU General Public License for more details.
+
+     You should have received a copy of the GNU General Public License along
+     with this program; if not, write to the Free Software Foundation, Inc.,
+           51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+                  For information regarding this software email:
+                                 Joseph Coffland
+                          joseph@cauldrondevelopment.com
+
+\******************************************************************************/
+
+#include "Decoder.h"
+
+#include <cbang/Exception.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstring>
+
+using namespace std;
+using namespace cb;
+using namespace FAH::PyON;
+
+
+namespace {
+  const double pow10[] = {
+    1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+  };
+
+
+  double scale10(double x, int exp) {
+    if (0 <= exp && exp <= 22) return x * pow10[exp];
+    if (-22 <= exp && exp < 0) return x / pow10[-exp];
+    return x * pow(10.0, exp);
+  }
+
+
+  bool isDigit(char c) {return '0' <= c && c <= '9';}
+
+
+  int hexValue(char c) {
+    if (isDigit(c)) return c - '0';
+    if ('a' <= c && c <= 'f') return c - 'a' + 10;
+    if ('A' <= c && c <= 'F') return c - 'A' + 10;
+    return -1;
+  }
+}
+
+
+unsigned Decoder::count(char c) const {return std::count(ptr, end, c);}
+
+
+void Decoder::skipWhitespace() {
+  while (ptr < end &&
+         (*ptr == ' ' || *ptr == '\n' || *ptr == '\r' || *ptr == '\t'))
+    ptr++;
+}
+
+
+char Decoder::peek() {
+  skipWhitespace();
+  if (ptr == end) error("Unexpected end of input");
+  return *ptr;
+}
+
+
+bool Decoder::tryChar(char c) {
+  if (peek() != c) return false;
+  ptr++;
+  return true;
+}
+
+
+void Decoder::expect(char c) {
+  if (!tryChar(c)) error(string("Expected '") + c + "'");
+}
+
+
+bool Decoder::nextItem(char close) {
+  if (tryChar(close)) return true;
+  expect(',');
+  return tryChar(close);
+}
+
+
+double Decoder::parseNumber() {
+  skipWhitespace();
+
+  bool negative = false;
+  if (ptr < end && (*ptr == '-' || *ptr == '+')) negative = *ptr++ == '-';
+
+  // Accumulate up to 19 significant digits, the rest only move the exponent
+  uint64_t mantissa = 0;
+  unsigned digits = 0;
+  int exp = 0;
+  bool any = false;
+
+  for (; ptr < end && isDigit(*ptr); ptr++, any = true)
+    if (digits < 19) {
+      mantissa = mantissa * 10 + (*ptr - '0');
+      if (mantissa) digits++;
+    } else exp++;
+
+  if (ptr < end && *ptr == '.')
+    for (ptr++; ptr < end && isDigit(*ptr); ptr++, any = true)
+      if (digits < 19) {
+        mantissa = mantissa * 10 + (*ptr - '0');
+        if (mantissa) digits++;
+        exp--;
+      }
+
+  if (!any) error("Expected number");
+
+  if (ptr < end && (*ptr == 'e' || *ptr == 'E')) {
+    ptr++;
+
+    bool expNegative = false;
+    if (ptr < end && (*ptr == '-' || *ptr == '+'))
+      expNegative = *ptr++ == '-';
+    if (ptr == end || !isDigit(*ptr)) error("Invalid exponent");
+
+    int e = 0;
+    for (; ptr < end && isDigit(*ptr); ptr++)
+      if (e < 10000) e = e * 10 + (*ptr - '0');
+
+    exp += expNegative ? -e : e;
+  }
+
+  double x = scale10((double)mantissa, exp);
+  return negative ? -x : x;
+}
+
+
+string Decoder::parseString() {
+  char quote = peek();
+  if (quote != '"' && quote != '\'') error("Expected string");
+  ptr++;
+
+  string s;
+  while (true) {
+    const char *next = ptr;
+    while (next < end && *next != quote && *next != '\\') next++;
+    s.append(ptr, next);
+    ptr = next;
+
+    if (ptr == end) error("Unterminated string");
+    if (*ptr++ == quote) return s;
+
+    // Escape
+    if (ptr == end) error("Unterminated string");
+    char c = *ptr++;
+    switch (c) {
+    case 'b': s += '\b'; break;
+    case 'f': s += '\f'; break;
+    case 'n': s += '\n'; break;
+    case 'r': s += '\r'; break;
+    case 't': s += '\t'; break;
+
+    case 'x': case 'u': {
+      unsigned len = c == 'x' ? 2 : 4;
+      if (end < ptr + len) error("Unterminated string");
+
+      unsigned code = 0;
+      for (unsigned i = 0; i < len; i++) {
+        int v = hexValue(*ptr++);
+        if (v < 0) error("Invalid escape");
+        code = (code << 4) | v;
+      }
+
+      // Encode as UTF-8
+      if (code < 0x80) s += (char)code;
+      else if (code < 0x800) {
+        s += (char)(0xc0 | (code >> 6));
+        s += (char)(0x80 | (code & 0x3f));
+
+      } else {
+        s += (char)(0xe0 | (code >> 12));
+        s += (char)(0x80 | ((code >> 6) & 0x3f));
+        s += (char)(0x80 | (code & 0x3f));
+      }
+      break;
+    }
+
+    default: s += c; break; // Includes quotes, '\\' and '/'
+    }
+  }
+}
+
+
+string Decoder::parseKey() {
+  char c = peek();
+  if (c == '"' || c == '\'') return parseString();
+
+  const char *next = ptr;
+  while (next < end && (isalnum(*next) || *next == '_')) next++;
+  if (next == ptr) error("Expected name");
+
+  string key(ptr, next);
+  ptr = next;
+  return key;
+}
+
+
+void Decoder::skipValue() {
+  switch (peek()) {
+  case '[': case '{': {
+    char close = *ptr++ == '[' ? ']' : '}';
+    bool dict = close == '}';
+
+    if (!tryChar(close))
+      do {
+        if (dict) {
+          parseKey();
+          expect(':');
+        }
+        skipValue();
+      } while (!nextItem(close));
+    break;
+  }
+
+  case '"': case '\'': parseString(); break;
+
+  default:
+    if (tryWord("None") || tryWord("null") || tryWord("True") ||
+        tryWord("true") || tryWord("False") || tryWord("false")) break;
+    parseNumber();
+    break;
+  }
+}
+
+
+bool Decoder::tryWord(const char *word) {
+  unsigned len = strlen(word);
+  if ((unsigned)(end - ptr) < len || strncmp(ptr, word, len)) return false;
+  ptr += len;
+  return true;
+}
+
+
+void Decoder::error(const string &msg) const {
+  THROW("PyON: " << msg << " at offset " << (ptr - start));
+}
@@ -0,0 +1,77 @@
+/******************************************************************************\
+
+                       This file is part of the FAHViewer.
+
+            The FAHViewer displays 3D views of Folding@home proteins.
+                    Copyright (c) 2016-2020, foldingathome.org
+                   Copyright (c) 2003-2016, Stanford University
+                               All rights reserved.
+
+       This program is free software; you can redistribute it and/or modify
+       it under the terms of the GNU General Public License as published by
+        the Free Software Foundation; either version 2 of the License, or
+                       (at your option) any later version.
+
+         This program is distributed in the hope that it will be useful,
+          but WITHOUT ANY WARRANTY; without even the implied warranty of
+          MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+                   GNU General Public License for more details.
+
+     You should have received a copy of the GNU General Public License along
+     with this program; if not, write to the Free Software Foundation, Inc.,
+           51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+                  For information regarding this software email:
+                                 Joseph Coffland
+                          joseph@cauldrondevelopment.com
+
+\******************************************************************************/
+
+#pragma once
+
+#include <string>
+#include <cstdint>
+
+
+namespace FAH {
+  namespace PyON {
+    /// A minimal pull tokenizer over an in-memory PyON value.  Lets bulk
+    /// message types be decoded straight into their final form without
+    /// first building a JSON DOM.
+    class Decoder {
+      const char *start;
+      const char *ptr;
+      const char *end;
+
+    public:
+      Decoder(const char *start, const char *end) :
+        start(start), ptr(start), end(end) {}
+
+      const char *getPosition() const {return ptr;}
+      unsigned getOffset() const {return ptr - start;}
+      bool atEnd() {skipWhitespace(); return ptr == end;}
+
+      /// Number of occurences of @param c in the remaining input
+      unsigned count(char c) const;
+
+      void skipWhitespace();
+      char peek();
+      bool tryChar(char c);
+      void expect(char c);
+
+      /// Consumes a list separator, returns true at the end of the list.
+      /// Python style trailing commas are allowed.
+      bool nextItem(char close);
+
+      double parseNumber();
+      std::string parseString();
+      /// A quoted string or a bare name, as used for dict keys
+      std::string parseKey();
+      void skipValue();
+
+    protected:
+      bool tryWord(const char *word);
+      void error(const std::string &msg) const;
+    };
+  }
+}
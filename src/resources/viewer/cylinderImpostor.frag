@@ -0,0 +1,49 @@
+// Fragment shader for ray-cast cylinder impostors.  Intersects the view ray
+// with the open cylinder between the two end points.  The ends are covered
+// by the atom spheres.  Each half takes the material of its atom.
+
+varying vec3 left;
+varying vec3 right;
+varying float radius;
+varying vec3 ecPosition;
+varying vec4 leftDiffuse;
+varying vec4 rightDiffuse;
+varying vec4 leftSpecular;
+varying vec4 rightSpecular;
+
+
+// shade() is defined in shade.glsl
+
+
+void main() {
+  vec3 rd = vec3(0.0, 0.0, -1.0);
+  vec3 ba = right - left;
+  vec3 oc = ecPosition - left;
+
+  float baba = dot(ba, ba);
+  float bard = dot(ba, rd);
+  float baoc = dot(ba, oc);
+
+  // Looking straight down the axis, the atoms cover the bond
+  float k2 = baba - bard * bard;
+  if (k2 <= 0.0) discard;
+
+  float k1 = baba * dot(oc, rd) - baoc * bard;
+  float k0 = baba * dot(oc, oc) - baoc * baoc - radius * radius * baba;
+  float h = k1 * k1 - k2 * k0;
+  if (h < 0.0) discard;
+
+  float t = (-k1 - sqrt(h)) / k2;
+  float y = baoc + t * bard;
+  if (y < 0.0 || baba < y) discard;
+
+  vec3 p = ecPosition + t * rd;
+  vec3 n = (oc + t * rd - ba * (y / baba)) / radius;
+  vec4 clip = gl_ProjectionMatrix * vec4(p, 1.0);
+
+  gl_FragDepth = 0.5 * (gl_DepthRange.diff * clip.z / clip.w +
+                        gl_DepthRange.near + gl_DepthRange.far);
+
+  if (y < 0.5 * baba) gl_FragColor = shade(n, leftDiffuse, leftSpecular);
+  else gl_FragColor = shade(n, rightDiffuse, rightSpecular);
+}
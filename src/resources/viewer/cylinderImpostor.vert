@@ -0,0 +1,43 @@
+// Vertex shader for ray-cast cylinder impostors.  Each bond is drawn as a
+// screen aligned quad covering the projection of the cylinder, placed just
+// in front of it.  Assumes an orthographic projection.
+
+attribute vec4 impostorLeft; // xyz end point, w radius
+attribute vec4 impostorRight;
+attribute vec4 impostorLeftDiffuse;
+attribute vec4 impostorRightDiffuse;
+attribute vec4 impostorLeftSpecular; // rgb specular, a shininess
+attribute vec4 impostorRightSpecular;
+
+varying vec3 left;
+varying vec3 right;
+varying float radius;
+varying vec3 ecPosition;
+varying vec4 leftDiffuse;
+varying vec4 rightDiffuse;
+varying vec4 leftSpecular;
+varying vec4 rightSpecular;
+
+void main() {
+  left = vec3(gl_ModelViewMatrix * vec4(impostorLeft.xyz, 1.0));
+  right = vec3(gl_ModelViewMatrix * vec4(impostorRight.xyz, 1.0));
+  radius = impostorLeft.w;
+  leftDiffuse = impostorLeftDiffuse;
+  rightDiffuse = impostorRightDiffuse;
+  leftSpecular = impostorLeftSpecular;
+  rightSpecular = impostorRightSpecular;
+
+  // Orient the quad along the projected axis
+  vec2 axis = right.xy - left.xy;
+  float len = length(axis);
+  vec2 u = 0.000001 < len ? axis / len : vec2(1.0, 0.0);
+  vec2 v = vec2(-u.y, u.x);
+  vec2 mid = 0.5 * (left.xy + right.xy);
+
+  // gl_Vertex.xy is a quad corner in [-1, 1]
+  vec2 xy = mid + u * gl_Vertex.x * (0.5 * len + radius) +
+    v * gl_Vertex.y * radius;
+
+  ecPosition = vec3(xy, max(left.z, right.z) + radius);
+  gl_Position = gl_ProjectionMatrix * vec4(ecPosition, 1.0);
+}
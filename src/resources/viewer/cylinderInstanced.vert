@@ -0,0 +1,34 @@
+// Vertex shader for instanced bond cylinders.  The unit cylinder mesh runs
+// along z and each instance supplies the transform onto its bond along with
+// its own material.
+
+attribute vec4 instanceOrigin;   // xyz start of the cylinder
+attribute vec4 instanceAxis;     // xyz direction scaled by length
+attribute vec4 instanceSide;     // xyz unit vector perpendicular to axis
+attribute vec4 instanceDiffuse;
+attribute vec4 instanceSpecular; // rgb specular, a shininess
+
+varying vec3 normal;
+varying vec3 ecPosition;
+varying vec4 diffuse;
+varying vec4 specular;
+
+void main() {
+  vec3 axis = instanceAxis.xyz;
+  vec3 side = instanceSide.xyz;
+  vec3 up = normalize(cross(axis, side));
+
+  vec4 vertex = vec4(instanceOrigin.xyz + side * gl_Vertex.x +
+                     up * gl_Vertex.y + axis * gl_Vertex.z, 1.0);
+  vec4 ecPos = gl_ModelViewMatrix * vertex;
+
+  vec3 n = side * gl_Normal.x + up * gl_Normal.y +
+    normalize(axis) * gl_Normal.z;
+
+  normal = normalize(gl_NormalMatrix * n);
+  ecPosition = ecPos.xyz;
+  diffuse = instanceDiffuse;
+  specular = instanceSpecular;
+
+  gl_Position = gl_ProjectionMatrix * ecPos;
+}
@@ -0,0 +1,23 @@
+// Lighting shared by the instanced and impostor fragment shaders.  Matches
+// the fixed function lighting of the mesh path with two directional lights.
+// ShaderProgram prepends this file to fragment shaders which ask for it.
+
+vec4 shade(vec3 n, vec4 diffuse, vec4 specular) {
+  vec4 ambient = gl_FrontMaterial.ambient;
+  vec4 color = gl_LightModel.ambient * ambient;
+
+  for (int i = 0; i < 2; i++) {
+    vec3 lightDir = normalize(gl_LightSource[i].position.xyz);
+    vec3 halfV = normalize(lightDir + vec3(0.0, 0.0, 1.0));
+    float NdotL = max(dot(n, lightDir), 0.0);
+
+    color += gl_LightSource[i].ambient * ambient;
+    color += NdotL * gl_LightSource[i].diffuse * diffuse;
+
+    if (0.0 < NdotL)
+      color += pow(max(dot(n, halfV), 0.0), specular.a) *
+        gl_LightSource[i].specular * vec4(specular.rgb, 1.0);
+  }
+
+  return vec4(color.rgb, diffuse.a);
+}
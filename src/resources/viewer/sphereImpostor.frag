@@ -0,0 +1,26 @@
+// Fragment shader for ray-cast sphere impostors.  Finds where the view ray
+// hits the sphere, writes that depth and shades it with the same two light
+// model as the mesh spheres.
+
+varying vec3 center;
+varying float radius;
+varying vec3 ecPosition;
+varying vec4 diffuse;
+varying vec4 specular;
+
+
+// shade() is defined in shade.glsl
+
+
+void main() {
+  vec2 d = (ecPosition.xy - center.xy) / radius;
+  float d2 = dot(d, d);
+  if (1.0 < d2) discard;
+
+  vec3 n = vec3(d, sqrt(1.0 - d2));
+  vec4 clip = gl_ProjectionMatrix * vec4(center + n * radius, 1.0);
+
+  gl_FragDepth = 0.5 * (gl_DepthRange.diff * clip.z / clip.w +
+                        gl_DepthRange.near + gl_DepthRange.far);
+  gl_FragColor = shade(n, diffuse, specular);
+}
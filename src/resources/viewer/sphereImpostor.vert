@@ -0,0 +1,24 @@
+// Vertex shader for ray-cast sphere impostors.  Each sphere is drawn as a
+// screen aligned quad placed just in front of it.  The viewer uses an
+// orthographic projection so all view rays run along -z in eye space.
+
+attribute vec4 impostorCenter; // xyz center, w radius
+attribute vec4 impostorDiffuse;
+attribute vec4 impostorSpecular; // rgb specular, a shininess
+
+varying vec3 center;
+varying float radius;
+varying vec3 ecPosition;
+varying vec4 diffuse;
+varying vec4 specular;
+
+void main() {
+  center = vec3(gl_ModelViewMatrix * vec4(impostorCenter.xyz, 1.0));
+  radius = impostorCenter.w;
+  diffuse = impostorDiffuse;
+  specular = impostorSpecular;
+
+  // gl_Vertex.xy is a quad corner in [-1, 1]
+  ecPosition = center + vec3(gl_Vertex.xy * radius, radius);
+  gl_Position = gl_ProjectionMatrix * vec4(ecPosition, 1.0);
+}
@@ -0,0 +1,15 @@
+// Fragment shader for instanced atom spheres and bond cylinders.  Lit like
+// the non-instanced path, see shade.glsl.
+
+varying vec3 normal;
+varying vec3 ecPosition;
+varying vec4 diffuse;
+varying vec4 specular;
+
+
+// shade() is defined in shade.glsl
+
+
+void main() {
+  gl_FragColor = shade(normalize(normal), diffuse, specular);
+}
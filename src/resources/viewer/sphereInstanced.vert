@@ -0,0 +1,24 @@
+// Vertex shader for instanced atom spheres.  The sphere mesh is shared and
+// each instance supplies its own position, scale and material.
+
+attribute vec4 instancePosition; // xyz position, w scale
+attribute vec4 instanceDiffuse;
+attribute vec4 instanceSpecular; // rgb specular, a shininess
+
+varying vec3 normal;
+varying vec3 ecPosition;
+varying vec4 diffuse;
+varying vec4 specular;
+
+void main() {
+  vec4 vertex =
+    vec4(gl_Vertex.xyz * instancePosition.w + instancePosition.xyz, 1.0);
+  vec4 ecPos = gl_ModelViewMatrix * vertex;
+
+  normal = normalize(gl_NormalMatrix * gl_Normal);
+  ecPosition = ecPos.xyz;
+  diffuse = instanceDiffuse;
+  specular = instanceSpecular;
+
+  gl_Position = gl_ProjectionMatrix * ecPos;
+}